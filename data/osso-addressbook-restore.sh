@@ -17,6 +17,32 @@ if [ ! -e $BACKUP_DIR ]; then
   exit 0
 fi
 
+if [ -d $BACKUP_DIR/generations ]; then
+  # A backup store, the address book verifies the newest generation and loads
+  # it into the books while EDS keeps running. The store stays, so the next
+  # backup only writes what changed since. A running address book would hold
+  # the D-Bus name.
+  OSSO_ABOOK_PIDS=`pidof osso-addressbook` || true
+  if [ -n "$OSSO_ABOOK_PIDS" ]; then
+    kill $OSSO_ABOOK_PIDS || true
+  fi
+
+  # It has to be gone before we take the name, give it 10 seconds
+  WAIT=10
+  while [ $WAIT -gt 0 ] && pidof osso-addressbook > /dev/null; do
+    sleep 1
+    WAIT=$((WAIT - 1))
+  done
+
+  OSSO_ABOOK_PIDS=`pidof osso-addressbook` || true
+  if [ -n "$OSSO_ABOOK_PIDS" ]; then
+    kill -9 $OSSO_ABOOK_PIDS || true
+    sleep 1
+  fi
+
+  exec osso-addressbook --restore $BACKUP_DIR
+fi
+
 rm -rf $RESTORE_DIR || true
 mv $BACKUP_DIR $RESTORE_DIR
 
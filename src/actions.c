@@ -43,6 +43,7 @@
 
 #include "actions.h"
 #include "contacts.h"
+#include "exporter.h"
 #include "groups.h"
 #include "menu.h"
 #include "sim.h"
@@ -513,8 +514,8 @@ view_mecard_cb(GtkWidget *button, osso_abook_data *data)
 static void
 export_cb(GtkWidget *button, osso_abook_data *data)
 {
-  /* implement me */
-  g_assert(0);
+  gtk_widget_hide(data->live_search);
+  do_export(GTK_WINDOW(data->window), OSSO_ABOOK_AGGREGATOR(data->aggregator));
 }
 
 static void
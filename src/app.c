@@ -41,9 +41,11 @@
 #include "groups.h"
 #include "contacts.h"
 #include "importer.h"
+#include "import-journal.h"
 #include "menu.h"
 #include "hw.h"
 #include "utils.h"
+#include "trace.h"
 
 static gboolean idle_import(gpointer user_data);
 
@@ -485,10 +487,10 @@ new_import_operation(gpointer user_data, int argc, gchar **argv)
   {
     char *arg = argv[i];
 
-    if (strncmp(arg, "file://", 7))
-      op->argv[i] = g_strdup(arg);
-    else
+    if (g_path_is_absolute(arg))
       op->argv[i] = g_filename_to_uri(arg, NULL, NULL);
+    else
+      op->argv[i] = g_strdup(arg);
   }
 
   qsort(op->argv, op->argc, sizeof(op->argv[0]), (__compar_fn_t)g_strcmp0);
@@ -544,11 +546,29 @@ aggregator_sequence_complete_cb(OssoABookRoster *roster, guint status,
                                 gpointer user_data)
 {
   osso_abook_data *data = user_data;
+  EBook *book;
 
   g_signal_handler_disconnect(data->aggregator, data->sequence_complete_id);
+  trace_async_end("first sequence-complete");
 
   data->unk1 = 1;
 
+  /* imports to the system book we died in the middle of, the ones to other
+   * books are resumed by whoever started them */
+  book = osso_abook_system_book_dup_singleton(FALSE, NULL);
+
+  if (book)
+  {
+    gchar **pending = import_journal_list_pending(
+          e_source_get_uid(e_book_get_source(book)));
+
+    if (*pending)
+      new_import_operation(data, g_strv_length(pending), pending);
+
+    g_strfreev(pending);
+    g_object_unref(book);
+  }
+
   if (data->import_operations && !data->import_started )
   {
     data->import_started = TRUE;
@@ -557,6 +577,9 @@ aggregator_sequence_complete_cb(OssoABookRoster *roster, guint status,
 
   set_title(data);
   update_menu(data);
+
+  /* the contacts are there, so is the cold start */
+  trace_write();
 }
 
 static void
@@ -829,10 +852,6 @@ create_menu(osso_abook_data *data, OssoABookMenuEntry *entries,
     map_cb = (void (*)(void))toggle_menu;
 
   g_signal_connect(menu, "map", map_cb, data);
-
-  if (entries == sim_bt_menu_actions)
-    return;
-
   hildon_window_set_app_menu(HILDON_WINDOW(data->starter_window), menu);
   g_object_unref(accel_group);
   alignment = gtk_alignment_new(0.0, 0.0, 1.0, 1.0);
@@ -842,7 +861,8 @@ create_menu(osso_abook_data *data, OssoABookMenuEntry *entries,
 
   app_menu_set_disable_on_lowmem(menu, "edit-contact-button", TRUE);
 
-  if (hw_is_lowmem_mode())
+  /* SIM contacts are read-only, they can only be copied to the contacts */
+  if (hw_is_lowmem_mode() || entries == sim_bt_menu_actions)
     contact_starter = osso_abook_touch_contact_starter_new_with_contact(
                           GTK_WINDOW(data->starter_window), contact);
   else
@@ -1026,6 +1046,67 @@ sim_group_ready_cb(OssoABookWaitable *waitable, const GError *error,
                    gpointer data)
 {
   OSSO_ABOOK_NOTE(EDS, "SIM group ready (all SIM books available)");
+  trace_async_end("SIM group ready");
+}
+
+OssoABookGroup *
+app_ensure_sim_group(osso_abook_data *data)
+{
+  gint64 span;
+
+  if (data->sim_group)
+    return data->sim_group;
+
+  OSSO_ABOOK_NOTE(EDS, "creating SIM group");
+
+  if (data->sim_group_idle_id)
+  {
+    g_source_remove(data->sim_group_idle_id);
+    data->sim_group_idle_id = 0;
+  }
+
+  span = trace_begin();
+  trace_async_begin("SIM group ready");
+  data->sim_group = osso_abook_sim_group_new();
+
+  g_signal_connect(data->sim_group, "available",
+                   G_CALLBACK(sim_group_available_cb), data);
+  g_signal_connect(data->sim_group, "voicemail-contact-available",
+                   G_CALLBACK(sim_group_voicemail_contact_available_cb), data);
+  g_signal_connect(data->sim_group, "capabilities-available",
+                   G_CALLBACK(sim_group_capabilities_available_cb),data);
+  osso_abook_waitable_call_when_ready(OSSO_ABOOK_WAITABLE(data->sim_group),
+                                      sim_group_ready_cb, data, NULL);
+  trace_end("SIM group construction", span);
+
+  return data->sim_group;
+}
+
+static gboolean
+create_sim_group_idle_cb(gpointer user_data)
+{
+  osso_abook_data *data = user_data;
+
+  data->sim_group_idle_id = 0;
+  app_ensure_sim_group(data);
+
+  return FALSE;
+}
+
+static void
+aggregator_ready_sim_group_cb(OssoABookWaitable *waitable,
+                              const GError *error, gpointer user_data)
+{
+  osso_abook_data *data = user_data;
+
+  if (data->sim_group || data->sim_group_idle_id)
+    return;
+
+  /* redraws have a higher priority, so this runs once the main window has
+   * painted the contacts */
+  data->sim_group_idle_id =
+      gdk_threads_add_idle_full(G_PRIORITY_LOW, create_sim_group_idle_cb,
+                                data, NULL);
 }
 
 static void
@@ -1166,6 +1247,7 @@ app_create(osso_context_t *osso, const gchar *arg1, osso_abook_data *data)
   GConfValue *val;
   int contacts_mode;
   GError *error = NULL;
+  gint64 span;
 
   OSSO_ABOOK_LOCAL_TIMER_START(STARTUP, NULL);
   OSSO_ABOOK_NOTE(STARTUP, STARTUP_PROGRESS_SEPARATOR);
@@ -1180,15 +1262,19 @@ app_create(osso_context_t *osso, const gchar *arg1, osso_abook_data *data)
   if (arg1)
     data->arg1 = g_strdup(arg1);
 
+  span = trace_begin();
   g_signal_connect(osso_abook_roster_manager_get_default(), "roster-created",
                    G_CALLBACK(roster_created_cb), data);
   g_signal_connect(osso_abook_roster_manager_get_default(), "roster-removed",
                    G_CALLBACK(roster_removed_cb), data);
   g_signal_connect(osso_abook_account_manager_get_default(), "account-removed",
                    G_CALLBACK(account_removed_cb), data);
+  trace_end("roster manager hookup", span);
 
   OSSO_ABOOK_NOTE(STARTUP, STARTUP_PROGRESS_SEPARATOR);
 
+  span = trace_begin();
+  trace_async_begin("first sequence-complete");
   data->aggregator = osso_abook_aggregator_get_default(&error);
 
   if (data->aggregator)
@@ -1205,12 +1291,20 @@ app_create(osso_context_t *osso, const gchar *arg1, osso_abook_data *data)
                  NULL);
   }
   else
+  {
     osso_abook_handle_gerror(GTK_WINDOW(data->window), error);
+    trace_async_end("first sequence-complete");
+  }
 
+  trace_end("aggregator get", span);
+
+  span = trace_begin();
   desktop_service_init(data);
+  trace_end("desktop service", span);
 
   OSSO_ABOOK_NOTE(STARTUP, STARTUP_PROGRESS_SEPARATOR);
 
+  span = trace_begin();
   data->contacts_mode = 0;
   accel_group = gtk_accel_group_new();
   data->window = HILDON_STACKABLE_WINDOW(hildon_stackable_window_new());
@@ -1242,22 +1336,28 @@ app_create(osso_context_t *osso, const gchar *arg1, osso_abook_data *data)
                    G_CALLBACK(window_delete_event_cb), data);
   g_signal_connect(data->window, "notify::is-topmost",
                    G_CALLBACK(_window_is_topmost_cb), data);
+  trace_end("main window and menu", span);
 
   OSSO_ABOOK_NOTE(STARTUP, STARTUP_PROGRESS_SEPARATOR);
 
-  data->sim_group = osso_abook_sim_group_new();
-
-  g_signal_connect(data->sim_group, "available",
-                   G_CALLBACK(sim_group_available_cb), data);
-  g_signal_connect(data->sim_group, "voicemail-contact-available",
-                   G_CALLBACK(sim_group_voicemail_contact_available_cb), data);
-  g_signal_connect(data->sim_group, "capabilities-available",
-                   G_CALLBACK(sim_group_capabilities_available_cb),data);
-  osso_abook_waitable_call_when_ready(OSSO_ABOOK_WAITABLE(data->sim_group),
-                                      sim_group_ready_cb, data, NULL);
+  /* The SIM books are not needed for the contact list, create the group
+   * once the aggregator is done, unless something asks for it before */
+  if (data->aggregator)
+  {
+    osso_abook_waitable_call_when_ready(OSSO_ABOOK_WAITABLE(data->aggregator),
+                                        aggregator_ready_sim_group_cb, data,
+                                        NULL);
+  }
+  else
+  {
+    data->sim_group_idle_id =
+        gdk_threads_add_idle_full(G_PRIORITY_LOW, create_sim_group_idle_cb,
+                                  data, NULL);
+  }
 
   OSSO_ABOOK_NOTE(STARTUP, STARTUP_PROGRESS_SEPARATOR);
 
+  span = trace_begin();
   data->contact_model = osso_abook_contact_model_get_default();
   data->filter_model = osso_abook_filter_model_new(
         OSSO_ABOOK_LIST_STORE(data->contact_model));
@@ -1295,9 +1395,11 @@ app_create(osso_context_t *osso, const gchar *arg1, osso_abook_data *data)
   notify_model_cb(tree_view, NULL, data);
 
   gtk_container_add(GTK_CONTAINER(data->window), data->align);
+  trace_end("contact view creation", span);
 
   OSSO_ABOOK_NOTE(STARTUP, STARTUP_PROGRESS_SEPARATOR);
 
+  span = trace_begin();
   app_select_all_group(data);
 
   gconf = osso_abook_get_gconf_client();
@@ -1340,6 +1442,7 @@ app_create(osso_context_t *osso, const gchar *arg1, osso_abook_data *data)
     contacts_mode = 0;
 
   set_contacts_mode(data, contacts_mode);
+  trace_end("view setup and show", span);
 
   OSSO_ABOOK_NOTE(STARTUP, STARTUP_PROGRESS_SEPARATOR);
   OSSO_ABOOK_LOCAL_TIMER_END();
@@ -1367,6 +1470,9 @@ app_destroy(osso_abook_data *data)
 
   g_slist_free(data->service_groups);
 
+  if (data->sim_group_idle_id)
+    g_source_remove(data->sim_group_idle_id);
+
   if (data->arg1)
     g_free(data->arg1);
 
@@ -70,7 +70,9 @@ typedef struct
   gboolean sim_group_ready;
   gboolean voicemail_contact_available;
   gboolean sim_capabilities_available;
+  /* created on demand, use app_ensure_sim_group() unless sim_group_ready */
   OssoABookGroup *sim_group;
+  guint sim_group_idle_id;
   GtkWidget *delete_contacts_window;
   GtkWidget *delete_contact_view;
   GtkWidget *align;
@@ -121,6 +123,9 @@ contact_view_contact_activated_cb(OssoABookContactView *view,
 void
 app_select_all_group(osso_abook_data *data);
 
+OssoABookGroup *
+app_ensure_sim_group(osso_abook_data *data);
+
 #define IS_EMPTY(s) (!((s) && (((const char *)(s))[0])))
 
 #endif /* APP_H */
@@ -0,0 +1,622 @@
+/*
+ * backup-engine.c
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <libebook/libebook.h>
+#include <libosso-abook/osso-abook-log.h>
+
+#include <string.h>
+
+#include "backup-store.h"
+
+#include "backup-engine.h"
+
+/* The system book and the others of the local backend, and the roster caches
+ * of the IM accounts. SIM books are read from the card anyway. */
+static const gchar *backup_backends[] = { "local", "tp", NULL };
+
+/* Books are backed up one after another, each one from a single query, so the
+ * snapshot of a book is consistent even if it gets changed meanwhile. The
+ * store is only written from one worker thread at a time. */
+struct _backup_engine
+{
+  gchar *dir;
+  GCancellable *cancellable;
+  backup_engine_done_cb cb;
+  gpointer user_data;
+  GError *error;
+
+  backup_store *store;
+  gchar *generation;
+  ESourceRegistry *registry;
+  GList *sources;
+  ESource *source;
+  EBookClient *client;
+  GKeyFile *manifest;
+  GPtrArray *books;
+
+  gint64 start_time;
+  gint64 end_time;
+  int total_contacts;
+};
+
+typedef struct
+{
+  backup_engine *engine;
+  gchar *uid;
+  GSList *contacts;
+} backup_book;
+
+static void
+backup_next(backup_engine *engine);
+
+backup_engine *
+backup_engine_new(const gchar *dir, backup_engine_done_cb cb,
+                  gpointer user_data)
+{
+  backup_engine *engine;
+
+  g_return_val_if_fail(dir != NULL, NULL);
+
+  engine = g_new0(backup_engine, 1);
+  engine->dir = g_strdup(dir);
+  engine->cb = cb;
+  engine->user_data = user_data;
+  engine->cancellable = g_cancellable_new();
+  engine->manifest = g_key_file_new();
+  engine->books = g_ptr_array_new_with_free_func(g_free);
+
+  return engine;
+}
+
+void
+backup_engine_free(backup_engine *engine)
+{
+  if (!engine)
+    return;
+
+  g_list_free_full(engine->sources, g_object_unref);
+
+  if (engine->source)
+    g_object_unref(engine->source);
+
+  if (engine->client)
+    g_object_unref(engine->client);
+
+  if (engine->registry)
+    g_object_unref(engine->registry);
+
+  backup_store_free(engine->store);
+  g_free(engine->generation);
+  g_ptr_array_free(engine->books, TRUE);
+  g_key_file_free(engine->manifest);
+  g_clear_error(&engine->error);
+  g_object_unref(engine->cancellable);
+  g_free(engine->dir);
+  g_free(engine);
+}
+
+void
+backup_engine_cancel(backup_engine *engine)
+{
+  g_return_if_fail(engine != NULL);
+
+  g_cancellable_cancel(engine->cancellable);
+}
+
+void
+backup_engine_get_stats(backup_engine *engine, backup_stats *stats)
+{
+  g_return_if_fail(engine != NULL);
+  g_return_if_fail(stats != NULL);
+
+  stats->elapsed = (engine->end_time ? engine->end_time :
+                    g_get_monotonic_time()) - engine->start_time;
+  stats->books = engine->books->len;
+  stats->contacts = engine->total_contacts;
+  stats->written_bytes = engine->store ?
+    backup_store_get_written_bytes(engine->store) : 0;
+}
+
+const GError *
+backup_engine_get_error(backup_engine *engine)
+{
+  g_return_val_if_fail(engine != NULL, NULL);
+
+  return engine->error;
+}
+
+static void
+backup_set_error(backup_engine *engine, GError *error)
+{
+  if (!engine->error)
+    engine->error = error;
+  else
+    g_error_free(error);
+}
+
+static gboolean
+backup_done_cb(gpointer user_data)
+{
+  backup_engine *engine = user_data;
+
+  if (engine->cb)
+    engine->cb(engine, engine->user_data);
+
+  return FALSE;
+}
+
+static void
+backup_done(backup_engine *engine)
+{
+  engine->end_time = g_get_monotonic_time();
+
+  if (engine->error)
+    OSSO_ABOOK_WARN("Backup failed: %s", engine->error->message);
+  else
+  {
+    OSSO_ABOOK_NOTE(GENERIC, "backed up %d contacts from %d books to %s, "
+                    "%" G_GUINT64_FORMAT " bytes written, in %.2f s",
+                    engine->total_contacts, engine->books->len,
+                    engine->generation,
+                    backup_store_get_written_bytes(engine->store),
+                    (engine->end_time - engine->start_time) /
+                    (gdouble)G_USEC_PER_SEC);
+  }
+
+  g_idle_add(backup_done_cb, engine);
+}
+
+static void
+backup_commit_thread(GTask *task, gpointer source_object, gpointer task_data,
+                     GCancellable *cancellable)
+{
+  backup_engine *engine = task_data;
+  GError *error = NULL;
+
+  /* the manifest goes last, an incomplete generation is never picked */
+  if (!backup_store_commit_generation(engine->store, engine->generation,
+                                      engine->manifest, &error))
+  {
+    g_task_return_error(task, error);
+
+    return;
+  }
+
+  if (!backup_store_prune(engine->store, BACKUP_KEEP_GENERATIONS, &error))
+  {
+    OSSO_ABOOK_WARN("Cannot prune backups: %s", error->message);
+    g_error_free(error);
+  }
+
+  g_task_return_boolean(task, TRUE);
+}
+
+static void
+backup_commit_cb(GObject *source_object, GAsyncResult *res,
+                 gpointer user_data)
+{
+  backup_engine *engine = user_data;
+  GError *error = NULL;
+
+  if (!g_task_propagate_boolean(G_TASK(res), &error))
+    backup_set_error(engine, error);
+
+  backup_done(engine);
+}
+
+static void
+backup_finish(backup_engine *engine)
+{
+  GTask *task;
+
+  if (!engine->error && g_cancellable_is_cancelled(engine->cancellable))
+  {
+    g_set_error_literal(&engine->error, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                        "Backup cancelled");
+  }
+
+  if (engine->error)
+  {
+    backup_done(engine);
+
+    return;
+  }
+
+  g_key_file_set_integer(engine->manifest, BACKUP_MANIFEST_GROUP, "version",
+                         BACKUP_VERSION);
+  g_key_file_set_int64(engine->manifest, BACKUP_MANIFEST_GROUP, "time",
+                       g_get_real_time() / G_USEC_PER_SEC);
+  g_key_file_set_string_list(engine->manifest, BACKUP_MANIFEST_GROUP, "books",
+                             (const gchar * const *)engine->books->pdata,
+                             engine->books->len);
+
+  task = g_task_new(NULL, NULL, backup_commit_cb, engine);
+  g_task_set_task_data(task, engine, NULL);
+  g_task_run_in_thread(task, backup_commit_thread);
+  g_object_unref(task);
+}
+
+static void
+backup_book_free(backup_book *book)
+{
+  g_slist_free_full(book->contacts, g_object_unref);
+  g_free(book->uid);
+  g_free(book);
+}
+
+static gboolean
+backup_load_image(EVCardAttribute *attr, gchar **data, gsize *len)
+{
+  GList *values;
+  gchar *uri;
+  gchar *path;
+  gboolean rv = FALSE;
+
+  if (e_vcard_attribute_get_param(attr, EVC_ENCODING))
+  {
+    values = e_vcard_attribute_get_values_decoded(attr);
+
+    if (values && values->data)
+    {
+      GString *decoded = values->data;
+
+      *len = decoded->len;
+      *data = g_memdup(decoded->str, decoded->len);
+      rv = TRUE;
+    }
+
+    return rv;
+  }
+
+  /* the local backend keeps photos in files of its own */
+  uri = e_vcard_attribute_get_value(attr);
+  path = uri ? g_filename_from_uri(uri, NULL, NULL) : NULL;
+
+  if (path)
+    rv = g_file_get_contents(path, data, len, NULL);
+
+  g_free(path);
+  g_free(uri);
+
+  return rv;
+}
+
+/* Moves the image to a blob of its own, so unchanged photos are stored once
+ * and a changed contact does not drag them along */
+static gboolean
+backup_put_image(backup_store *store, EVCardAttribute *attr, GString *index,
+                 GError **error)
+{
+  GList *types;
+  gchar *type = NULL;
+  gchar *data;
+  gchar *hash;
+  gchar *uri;
+  gsize len;
+
+  /* remote URIs stay as they are */
+  if (!backup_load_image(attr, &data, &len))
+    return TRUE;
+
+  hash = backup_store_put(store, data, len, error);
+  g_free(data);
+
+  if (!hash)
+    return FALSE;
+
+  types = e_vcard_attribute_get_param(attr, EVC_TYPE);
+
+  if (types)
+    type = g_strdup(types->data);
+
+  e_vcard_attribute_remove_params(attr);
+  e_vcard_attribute_remove_values(attr);
+  e_vcard_attribute_add_param_with_value(
+        attr, e_vcard_attribute_param_new(EVC_VALUE), "uri");
+
+  if (type)
+  {
+    e_vcard_attribute_add_param_with_value(
+          attr, e_vcard_attribute_param_new(EVC_TYPE), type);
+  }
+
+  uri = g_strconcat(BACKUP_BLOB_SCHEME, hash, NULL);
+  e_vcard_attribute_add_value(attr, uri);
+  g_string_append_printf(index, " %s", hash);
+  g_free(uri);
+  g_free(type);
+  g_free(hash);
+
+  return TRUE;
+}
+
+static gboolean
+backup_put_contact(backup_store *store, EContact *contact, GString *index,
+                   GError **error)
+{
+  GString *blobs = g_string_new(NULL);
+  GList *l;
+  gchar *vcard;
+  gchar *hash;
+  gboolean rv = FALSE;
+
+  for (l = e_vcard_get_attributes(E_VCARD(contact)); l; l = l->next)
+  {
+    const char *name = e_vcard_attribute_get_name(l->data);
+
+    if (!g_ascii_strcasecmp(name, EVC_PHOTO) ||
+        !g_ascii_strcasecmp(name, EVC_LOGO))
+    {
+      if (!backup_put_image(store, l->data, blobs, error))
+      {
+        g_string_free(blobs, TRUE);
+
+        return FALSE;
+      }
+    }
+  }
+
+  vcard = e_vcard_to_string(E_VCARD(contact), EVC_FORMAT_VCARD_30);
+  hash = backup_store_put(store, vcard, strlen(vcard), error);
+  g_free(vcard);
+
+  if (hash)
+  {
+    g_string_append_printf(index, "%s%s\n", hash, blobs->str);
+    g_free(hash);
+    rv = TRUE;
+  }
+
+  g_string_free(blobs, TRUE);
+
+  return rv;
+}
+
+static void
+backup_book_thread(GTask *task, gpointer source_object, gpointer task_data,
+                   GCancellable *cancellable)
+{
+  backup_book *book = task_data;
+  backup_store *store = book->engine->store;
+  GString *index = g_string_new(NULL);
+  GError *error = NULL;
+  GSList *l;
+
+  for (l = book->contacts; l; l = l->next)
+  {
+    if (g_task_return_error_if_cancelled(task) ||
+        !backup_put_contact(store, l->data, index, &error))
+    {
+      if (error)
+        g_task_return_error(task, error);
+
+      g_string_free(index, TRUE);
+
+      return;
+    }
+  }
+
+  if (backup_store_write_index(store, book->engine->generation, book->uid,
+                               index->str, &error))
+  {
+    g_task_return_boolean(task, TRUE);
+  }
+  else
+    g_task_return_error(task, error);
+
+  g_string_free(index, TRUE);
+}
+
+static void
+backup_book_done(backup_engine *engine)
+{
+  g_clear_object(&engine->client);
+  g_clear_object(&engine->source);
+  backup_next(engine);
+}
+
+static void
+backup_book_cb(GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  backup_engine *engine = user_data;
+  backup_book *book = g_task_get_task_data(G_TASK(res));
+  GError *error = NULL;
+
+  if (g_task_propagate_boolean(G_TASK(res), &error))
+  {
+    int contacts = g_slist_length(book->contacts);
+
+    g_key_file_set_integer(engine->manifest, book->uid, "contacts", contacts);
+    g_ptr_array_add(engine->books, g_strdup(book->uid));
+    engine->total_contacts += contacts;
+  }
+  else
+    backup_set_error(engine, error);
+
+  backup_book_done(engine);
+}
+
+static void
+backup_get_contacts_cb(GObject *source_object, GAsyncResult *res,
+                       gpointer user_data)
+{
+  backup_engine *engine = user_data;
+  const gchar *uid = e_source_get_uid(engine->source);
+  ESourceBackend *backend;
+  backup_book *book;
+  GError *error = NULL;
+  GSList *contacts = NULL;
+  GTask *task;
+
+  if (!e_book_client_get_contacts_finish(E_BOOK_CLIENT(source_object), res,
+                                         &contacts, &error))
+  {
+    backup_set_error(engine, error);
+    backup_book_done(engine);
+
+    return;
+  }
+
+  backend = e_source_get_extension(engine->source,
+                                   E_SOURCE_EXTENSION_ADDRESS_BOOK);
+  g_key_file_set_string(engine->manifest, uid, "backend",
+                        e_source_backend_get_backend_name(backend));
+
+  if (e_source_get_parent(engine->source))
+  {
+    g_key_file_set_string(engine->manifest, uid, "parent",
+                          e_source_get_parent(engine->source));
+  }
+
+  if (e_source_get_display_name(engine->source))
+  {
+    g_key_file_set_string(engine->manifest, uid, "name",
+                          e_source_get_display_name(engine->source));
+  }
+
+  book = g_new0(backup_book, 1);
+  book->engine = engine;
+  book->uid = g_strdup(uid);
+  book->contacts = contacts;
+
+  /* hashing and photos take a while, keep them off the main loop */
+  task = g_task_new(NULL, engine->cancellable, backup_book_cb, engine);
+  g_task_set_task_data(task, book, (GDestroyNotify)backup_book_free);
+  g_task_run_in_thread(task, backup_book_thread);
+  g_object_unref(task);
+}
+
+static void
+backup_connect_cb(GObject *source_object, GAsyncResult *res,
+                  gpointer user_data)
+{
+  backup_engine *engine = user_data;
+  GError *error = NULL;
+  EClient *client = e_book_client_connect_finish(res, &error);
+  EBookQuery *query;
+  gchar *sexp;
+
+  if (!client)
+  {
+    backup_set_error(engine, error);
+    backup_book_done(engine);
+
+    return;
+  }
+
+  engine->client = E_BOOK_CLIENT(client);
+  query = e_book_query_any_field_contains("");
+  sexp = e_book_query_to_string(query);
+  e_book_client_get_contacts(engine->client, sexp, engine->cancellable,
+                             backup_get_contacts_cb, engine);
+  g_free(sexp);
+  e_book_query_unref(query);
+}
+
+static void
+backup_next(backup_engine *engine)
+{
+  if (engine->error || g_cancellable_is_cancelled(engine->cancellable) ||
+      !engine->sources)
+  {
+    backup_finish(engine);
+
+    return;
+  }
+
+  engine->source = engine->sources->data;
+  engine->sources = g_list_delete_link(engine->sources, engine->sources);
+
+  OSSO_ABOOK_NOTE(GENERIC, "backing up %s", e_source_get_uid(engine->source));
+
+  e_book_client_connect(engine->source, 30, engine->cancellable,
+                        backup_connect_cb, engine);
+}
+
+static gboolean
+backup_source_wanted(ESource *source)
+{
+  ESourceBackend *backend;
+  const gchar *name;
+
+  if (!e_source_get_enabled(source))
+    return FALSE;
+
+  backend = e_source_get_extension(source, E_SOURCE_EXTENSION_ADDRESS_BOOK);
+  name = e_source_backend_get_backend_name(backend);
+
+  return name && g_strv_contains(backup_backends, name);
+}
+
+static void
+backup_registry_cb(GObject *source_object, GAsyncResult *res,
+                   gpointer user_data)
+{
+  backup_engine *engine = user_data;
+  GError *error = NULL;
+  GList *sources;
+  GList *l;
+
+  engine->registry = e_source_registry_new_finish(res, &error);
+
+  if (!engine->registry)
+  {
+    backup_set_error(engine, error);
+    backup_finish(engine);
+
+    return;
+  }
+
+  sources = e_source_registry_list_sources(engine->registry,
+                                           E_SOURCE_EXTENSION_ADDRESS_BOOK);
+
+  for (l = sources; l; l = l->next)
+  {
+    if (backup_source_wanted(l->data))
+      engine->sources = g_list_prepend(engine->sources, g_object_ref(l->data));
+  }
+
+  g_list_free_full(sources, g_object_unref);
+  engine->sources = g_list_reverse(engine->sources);
+  backup_next(engine);
+}
+
+void
+backup_engine_start(backup_engine *engine)
+{
+  GError *error = NULL;
+
+  g_return_if_fail(engine != NULL);
+
+  engine->start_time = g_get_monotonic_time();
+  engine->store = backup_store_open(engine->dir, &error);
+
+  if (engine->store)
+    engine->generation = backup_store_new_generation(engine->store, &error);
+
+  if (!engine->generation)
+  {
+    backup_set_error(engine, error);
+    backup_finish(engine);
+
+    return;
+  }
+
+  e_source_registry_new(engine->cancellable, backup_registry_cb, engine);
+}
@@ -0,0 +1,67 @@
+/*
+ * backup-engine.h
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef BACKUP_ENGINE_H
+#define BACKUP_ENGINE_H
+
+#include <gio/gio.h>
+
+/* Generations older than that are dropped after a backup */
+#define BACKUP_KEEP_GENERATIONS 7
+
+typedef struct _backup_engine backup_engine;
+
+typedef struct
+{
+  /* in microseconds */
+  gint64 elapsed;
+  int books;
+  int contacts;
+  guint64 written_bytes;
+} backup_stats;
+
+typedef void (*backup_engine_done_cb)(backup_engine *engine,
+                                      gpointer user_data);
+
+/* Adds a generation with the local and the roster books to the backup store
+ * in dir, while EDS keeps running. Only contacts and photos not in the store
+ * yet get written. */
+backup_engine *
+backup_engine_new(const gchar *dir, backup_engine_done_cb cb,
+                  gpointer user_data);
+
+void
+backup_engine_free(backup_engine *engine);
+
+/* cb gets called once every book is written, the backup failed or got
+ * cancelled */
+void
+backup_engine_start(backup_engine *engine);
+
+void
+backup_engine_cancel(backup_engine *engine);
+
+void
+backup_engine_get_stats(backup_engine *engine, backup_stats *stats);
+
+/* NULL if the backup succeeded */
+const GError *
+backup_engine_get_error(backup_engine *engine);
+
+#endif // BACKUP_ENGINE_H
@@ -0,0 +1,526 @@
+/*
+ * backup-store.c
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <libosso-abook/osso-abook-log.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include "backup-store.h"
+
+#define MANIFEST "manifest"
+
+/* objects/ab/cdef... holds the object with SHA-1 abcdef..., a generation is
+ * generations/<time>/ with an index per book and the manifest */
+struct _backup_store
+{
+  gchar *objects;
+  gchar *generations;
+  guint64 written_bytes;
+};
+
+static gboolean
+make_directory(const gchar *path, GError **error)
+{
+  if (g_mkdir_with_parents(path, 0700))
+  {
+    int errsv = errno;
+
+    g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errsv),
+                "Cannot create %s: %s", path, g_strerror(errsv));
+
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+backup_store *
+backup_store_open(const gchar *dir, GError **error)
+{
+  backup_store *store;
+
+  g_return_val_if_fail(dir != NULL, NULL);
+
+  store = g_new0(backup_store, 1);
+  store->objects = g_build_filename(dir, "objects", NULL);
+  store->generations = g_build_filename(dir, "generations", NULL);
+
+  if (!make_directory(store->objects, error) ||
+      !make_directory(store->generations, error))
+  {
+    backup_store_free(store);
+
+    return NULL;
+  }
+
+  return store;
+}
+
+void
+backup_store_free(backup_store *store)
+{
+  if (!store)
+    return;
+
+  g_free(store->objects);
+  g_free(store->generations);
+  g_free(store);
+}
+
+static gboolean
+is_hash(const gchar *hash)
+{
+  const gchar *p;
+
+  for (p = hash; *p; p++)
+  {
+    if (!g_ascii_isxdigit(*p))
+      return FALSE;
+  }
+
+  return p - hash == 40;
+}
+
+static gchar *
+object_path(backup_store *store, const gchar *hash)
+{
+  gchar prefix[3] = { hash[0], hash[1], 0 };
+
+  return g_build_filename(store->objects, prefix, hash + 2, NULL);
+}
+
+gchar *
+backup_store_put(backup_store *store, gconstpointer data, gsize len,
+                 GError **error)
+{
+  gchar *hash;
+  gchar *path;
+  gchar *dir;
+
+  g_return_val_if_fail(store != NULL, NULL);
+
+  hash = g_compute_checksum_for_data(G_CHECKSUM_SHA1, data, len);
+  path = object_path(store, hash);
+
+  /* an unchanged object costs a lookup, nothing gets written */
+  if (g_file_test(path, G_FILE_TEST_EXISTS))
+  {
+    g_free(path);
+
+    return hash;
+  }
+
+  dir = g_path_get_dirname(path);
+
+  if (!make_directory(dir, error) ||
+      !g_file_set_contents(path, data, len, error))
+  {
+    g_free(hash);
+    hash = NULL;
+  }
+  else
+    store->written_bytes += len;
+
+  g_free(dir);
+  g_free(path);
+
+  return hash;
+}
+
+GBytes *
+backup_store_get(backup_store *store, const gchar *hash, GError **error)
+{
+  gchar *path;
+  gchar *data;
+  gchar *checksum;
+  gsize len;
+
+  g_return_val_if_fail(store != NULL, NULL);
+  g_return_val_if_fail(hash != NULL, NULL);
+
+  if (!is_hash(hash))
+  {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                "Invalid object name %s", hash);
+
+    return NULL;
+  }
+
+  path = object_path(store, hash);
+
+  if (!g_file_get_contents(path, &data, &len, error))
+  {
+    g_free(path);
+
+    return NULL;
+  }
+
+  g_free(path);
+  checksum = g_compute_checksum_for_data(G_CHECKSUM_SHA1, (guchar *)data, len);
+
+  if (g_ascii_strcasecmp(checksum, hash))
+  {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                "Object %s is corrupt", hash);
+    g_free(checksum);
+    g_free(data);
+
+    return NULL;
+  }
+
+  g_free(checksum);
+
+  return g_bytes_new_take(data, len);
+}
+
+guint64
+backup_store_get_written_bytes(backup_store *store)
+{
+  g_return_val_if_fail(store != NULL, 0);
+
+  return store->written_bytes;
+}
+
+gchar *
+backup_store_new_generation(backup_store *store, GError **error)
+{
+  GDateTime *now = g_date_time_new_now_utc();
+  gchar *generation = g_date_time_format(now, "%Y%m%dT%H%M%SZ");
+  gchar *path = g_build_filename(store->generations, generation, NULL);
+
+  g_date_time_unref(now);
+
+  if (!make_directory(path, error))
+  {
+    g_free(generation);
+    generation = NULL;
+  }
+
+  g_free(path);
+
+  return generation;
+}
+
+static gchar *
+index_path(backup_store *store, const gchar *generation, const gchar *uid)
+{
+  gchar *name = g_strconcat(uid, ".index", NULL);
+  gchar *path = g_build_filename(store->generations, generation, name, NULL);
+
+  g_free(name);
+
+  return path;
+}
+
+gboolean
+backup_store_write_index(backup_store *store, const gchar *generation,
+                         const gchar *uid, const gchar *index, GError **error)
+{
+  gchar *path;
+  gboolean rv;
+
+  g_return_val_if_fail(store != NULL, FALSE);
+
+  path = index_path(store, generation, uid);
+  rv = g_file_set_contents(path, index, -1, error);
+  g_free(path);
+
+  return rv;
+}
+
+gchar **
+backup_store_read_index(backup_store *store, const gchar *generation,
+                        const gchar *uid, GError **error)
+{
+  gchar *path;
+  gchar *contents;
+  gchar **lines;
+
+  g_return_val_if_fail(store != NULL, NULL);
+
+  path = index_path(store, generation, uid);
+
+  if (!g_file_get_contents(path, &contents, NULL, error))
+  {
+    g_free(path);
+
+    return NULL;
+  }
+
+  g_free(path);
+  lines = g_strsplit(g_strchomp(contents), "\n", -1);
+  g_free(contents);
+
+  return lines;
+}
+
+gboolean
+backup_store_commit_generation(backup_store *store, const gchar *generation,
+                               GKeyFile *manifest, GError **error)
+{
+  gchar *path;
+  gchar *data;
+  gsize len;
+  gboolean rv;
+
+  g_return_val_if_fail(store != NULL, FALSE);
+
+  path = g_build_filename(store->generations, generation, MANIFEST, NULL);
+  data = g_key_file_to_data(manifest, &len, NULL);
+  rv = g_file_set_contents(path, data, len, error);
+  g_free(data);
+  g_free(path);
+
+  return rv;
+}
+
+GKeyFile *
+backup_store_load_generation(backup_store *store, const gchar *generation,
+                             GError **error)
+{
+  GKeyFile *manifest = g_key_file_new();
+  gchar *path;
+
+  g_return_val_if_fail(store != NULL, NULL);
+
+  path = g_build_filename(store->generations, generation, MANIFEST, NULL);
+
+  if (!g_key_file_load_from_file(manifest, path, G_KEY_FILE_NONE, error))
+  {
+    g_key_file_free(manifest);
+    manifest = NULL;
+  }
+
+  g_free(path);
+
+  return manifest;
+}
+
+static gint
+compare_generations(gconstpointer a, gconstpointer b)
+{
+  return strcmp(*(const gchar **)a, *(const gchar **)b);
+}
+
+/* all the generations if complete is FALSE */
+static gchar **
+list_generations(backup_store *store, gboolean complete)
+{
+  GPtrArray *generations = g_ptr_array_new();
+  GDir *dir = g_dir_open(store->generations, 0, NULL);
+  const gchar *name;
+
+  while (dir && (name = g_dir_read_name(dir)))
+  {
+    gchar *path = g_build_filename(store->generations, name, MANIFEST, NULL);
+
+    if (!complete || g_file_test(path, G_FILE_TEST_IS_REGULAR))
+      g_ptr_array_add(generations, g_strdup(name));
+
+    g_free(path);
+  }
+
+  if (dir)
+    g_dir_close(dir);
+
+  g_ptr_array_sort(generations, compare_generations);
+  g_ptr_array_add(generations, NULL);
+
+  return (gchar **)g_ptr_array_free(generations, FALSE);
+}
+
+gchar **
+backup_store_list_generations(backup_store *store)
+{
+  g_return_val_if_fail(store != NULL, NULL);
+
+  return list_generations(store, TRUE);
+}
+
+/* generations and the fan-out directories of objects are flat */
+static void
+remove_directory(const gchar *path, GHashTable *keep)
+{
+  GDir *dir = g_dir_open(path, 0, NULL);
+  const gchar *name;
+
+  if (!dir)
+    return;
+
+  while ((name = g_dir_read_name(dir)))
+  {
+    gchar *file = g_build_filename(path, name, NULL);
+
+    if (!keep || !g_hash_table_contains(keep, file))
+      g_unlink(file);
+
+    g_free(file);
+  }
+
+  g_dir_close(dir);
+  g_rmdir(path);
+}
+
+/* An object that a generation refers to but is not seen here gets removed,
+ * so nothing must be missed */
+static gboolean
+add_references(backup_store *store, const gchar *generation,
+               GHashTable *referenced, GError **error)
+{
+  GKeyFile *manifest = backup_store_load_generation(store, generation, error);
+  gboolean rv = TRUE;
+  gchar **books;
+  gchar **book;
+
+  if (!manifest)
+    return FALSE;
+
+  books = g_key_file_get_string_list(manifest, BACKUP_MANIFEST_GROUP, "books",
+                                     NULL, error);
+
+  if (!books)
+    rv = FALSE;
+
+  for (book = books; rv && *book; book++)
+  {
+    gchar **lines = backup_store_read_index(store, generation, *book, error);
+    gchar **line;
+
+    if (!lines)
+    {
+      rv = FALSE;
+      break;
+    }
+
+    for (line = lines; *line; line++)
+    {
+      gchar **hashes = g_strsplit(*line, " ", -1);
+      gchar **hash;
+
+      for (hash = hashes; *hash; hash++)
+      {
+        if (is_hash(*hash))
+          g_hash_table_add(referenced, object_path(store, *hash));
+      }
+
+      g_strfreev(hashes);
+    }
+
+    g_strfreev(lines);
+  }
+
+  g_strfreev(books);
+  g_key_file_free(manifest);
+
+  return rv;
+}
+
+gboolean
+backup_store_prune(backup_store *store, guint keep, GError **error)
+{
+  gchar **generations;
+  gchar **complete;
+  guint count;
+  guint dropped = 0;
+  guint i;
+
+  g_return_val_if_fail(store != NULL, FALSE);
+
+  generations = list_generations(store, FALSE);
+  complete = list_generations(store, TRUE);
+  count = g_strv_length(complete);
+
+  /* incomplete generations are left over from failed backups */
+  for (i = 0; generations[i]; i++)
+  {
+    gboolean is_complete = g_strv_contains((const gchar * const *)complete,
+                                           generations[i]);
+
+    if (!is_complete || count > keep)
+    {
+      gchar *path = g_build_filename(store->generations, generations[i],
+                                     NULL);
+
+      OSSO_ABOOK_NOTE(GENERIC, "dropping backup generation %s",
+                      generations[i]);
+      remove_directory(path, NULL);
+      g_free(path);
+      dropped++;
+
+      if (is_complete)
+        count--;
+    }
+  }
+
+  g_strfreev(generations);
+  g_strfreev(complete);
+
+  /* objects can only become unreferenced if a generation is gone */
+  if (dropped)
+  {
+    GHashTable *referenced = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                   g_free, NULL);
+    GDir *dir;
+    const gchar *name;
+
+    gboolean rv = TRUE;
+
+    generations = list_generations(store, TRUE);
+
+    for (i = 0; rv && generations[i]; i++)
+      rv = add_references(store, generations[i], referenced, error);
+
+    g_strfreev(generations);
+
+    /* a generation that cannot be read might need any of the objects */
+    if (!rv)
+    {
+      g_hash_table_destroy(referenced);
+
+      return FALSE;
+    }
+
+    dir = g_dir_open(store->objects, 0, error);
+
+    if (!dir)
+    {
+      g_hash_table_destroy(referenced);
+
+      return FALSE;
+    }
+
+    while ((name = g_dir_read_name(dir)))
+    {
+      gchar *path = g_build_filename(store->objects, name, NULL);
+
+      /* removing the directory fails unless it is empty by now */
+      remove_directory(path, referenced);
+      g_free(path);
+    }
+
+    g_dir_close(dir);
+    g_hash_table_destroy(referenced);
+  }
+
+  return TRUE;
+}
@@ -0,0 +1,88 @@
+/*
+ * backup-store.h
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef BACKUP_STORE_H
+#define BACKUP_STORE_H
+
+#include <glib.h>
+
+/* Photos are stored as blobs of their own, the vCard refers to them with a
+ * PHOTO;VALUE=uri:backup-blob:<hash> */
+#define BACKUP_BLOB_SCHEME "backup-blob:"
+
+#define BACKUP_MANIFEST_GROUP "backup"
+#define BACKUP_VERSION 2
+
+typedef struct _backup_store backup_store;
+
+/* Creates the store in dir if it is not there yet */
+backup_store *
+backup_store_open(const gchar *dir, GError **error);
+
+void
+backup_store_free(backup_store *store);
+
+/* Returns the hash data is stored under, it is written only if it is not in
+ * the store already. Safe to call from one thread at a time. */
+gchar *
+backup_store_put(backup_store *store, gconstpointer data, gsize len,
+                 GError **error);
+
+/* Fails if the object is missing or does not match its hash */
+GBytes *
+backup_store_get(backup_store *store, const gchar *hash, GError **error);
+
+/* Bytes written to the store by backup_store_put() */
+guint64
+backup_store_get_written_bytes(backup_store *store);
+
+/* Returns the name of a new, empty, generation */
+gchar *
+backup_store_new_generation(backup_store *store, GError **error);
+
+/* The objects of a book, each line is a vCard hash, followed by the hashes of
+ * the blobs the vCard refers to */
+gboolean
+backup_store_write_index(backup_store *store, const gchar *generation,
+                         const gchar *uid, const gchar *index, GError **error);
+
+gchar **
+backup_store_read_index(backup_store *store, const gchar *generation,
+                        const gchar *uid, GError **error);
+
+/* A generation is complete once its manifest is written */
+gboolean
+backup_store_commit_generation(backup_store *store, const gchar *generation,
+                               GKeyFile *manifest, GError **error);
+
+GKeyFile *
+backup_store_load_generation(backup_store *store, const gchar *generation,
+                             GError **error);
+
+/* Complete generations, the oldest first */
+gchar **
+backup_store_list_generations(backup_store *store);
+
+/* Drops all but the newest keep generations, and the objects none of the
+ * remaining ones refers to. No object is dropped if any of those cannot be
+ * read. */
+gboolean
+backup_store_prune(backup_store *store, guint keep, GError **error);
+
+#endif // BACKUP_STORE_H
@@ -0,0 +1,628 @@
+/*
+ * batch.c
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Imports and exports vCards without any UI, to provision devices, to archive
+ * them and to benchmark the importer */
+
+#include <glib-unix.h>
+#include <gio/gio.h>
+
+#include <libedataserver/libedataserver.h>
+
+#include <libintl.h>
+#include <locale.h>
+#include <signal.h>
+
+#include "export-checkpoint.h"
+#include "export-engine.h"
+#include "import-engine.h"
+#include "osso-abook-sim-group.h"
+
+static gchar *book_uid = NULL;
+static gboolean scratch = FALSE;
+static gboolean journal = FALSE;
+static gchar *export_path = NULL;
+static gboolean delta = FALSE;
+static gchar *fake_sim_dir = NULL;
+static gboolean remove_fake_sim = FALSE;
+
+static const char *fake_sim_books[] =
+{
+  "adn",
+  "sdn",
+  "mbdn",
+  "vmbx",
+  "en",
+  NULL
+};
+
+static GOptionEntry entries[] =
+{
+  {
+    "book", 'b', 0, G_OPTION_ARG_STRING, &book_uid,
+    "UID of the address book to import to, the system one by default", "UID"
+  },
+  {
+    "scratch", 's', 0, G_OPTION_ARG_NONE, &scratch,
+    "Import to a new local address book, removed when done", NULL
+  },
+  {
+    "journal", 'j', 0, G_OPTION_ARG_NONE, &journal,
+    "Keep a journal, so an interrupted import gets resumed", NULL
+  },
+  {
+    "export", 'e', 0, G_OPTION_ARG_FILENAME, &export_path,
+    "Export the address book to FILE instead of importing", "FILE"
+  },
+  {
+    "delta", 'd', 0, G_OPTION_ARG_NONE, &delta,
+    "Only export what changed since the last delta export of the book, the "
+    "UIDs of deleted contacts go to FILE.deleted", NULL
+  },
+  {
+    "fake-sim", 'f', 0, G_OPTION_ARG_FILENAME, &fake_sim_dir,
+    "Fill the books of a fake SIM from DIR/adn.vcf, DIR/sdn.vcf and so on, for "
+    "a SIM group running with OSSO_ABOOK_FAKE_SIM set", "DIR"
+  },
+  {
+    "remove-fake-sim", 'r', 0, G_OPTION_ARG_NONE, &remove_fake_sim,
+    "Remove the books of the fake SIM", NULL
+  },
+  { NULL }
+};
+
+static void
+import_done_cb(import_engine *engine, gpointer user_data)
+{
+  g_main_loop_quit(user_data);
+}
+
+static void
+export_done_cb(export_engine *engine, gpointer user_data)
+{
+  g_main_loop_quit(user_data);
+}
+
+static gboolean
+import_interrupt_cb(gpointer user_data)
+{
+  import_engine_cancel(user_data);
+
+  return TRUE;
+}
+
+static gboolean
+export_interrupt_cb(gpointer user_data)
+{
+  export_engine_cancel(user_data);
+
+  return TRUE;
+}
+
+static ESource *
+commit_local_book(ESourceRegistry *registry, ESource *source, GError **error)
+{
+  ESource *added;
+  ESourceBackend *backend;
+
+  e_source_set_parent(source, "local-stub");
+  backend = e_source_get_extension(source, E_SOURCE_EXTENSION_ADDRESS_BOOK);
+  e_source_backend_set_backend_name(backend, "local");
+
+  if (!e_source_registry_commit_source_sync(registry, source, NULL, error))
+  {
+    g_object_unref(source);
+
+    return NULL;
+  }
+
+  /* only the registry's own copy can be removed later */
+  while (!(added = e_source_registry_ref_source(registry,
+                                                e_source_get_uid(source))))
+  {
+    g_main_context_iteration(NULL, TRUE);
+  }
+
+  g_object_unref(source);
+
+  return added;
+}
+
+/* A file-backed book of the local backend, so benchmarks don't depend on
+ * whatever the system book holds */
+static ESource *
+create_scratch_book(ESourceRegistry *registry, GError **error)
+{
+  ESource *source = e_source_new(NULL, NULL, error);
+
+  if (!source)
+    return NULL;
+
+  e_source_set_display_name(source, "osso-addressbook-batch");
+
+  return commit_local_book(registry, source, error);
+}
+
+/* With OSSO_ABOOK_FAKE_SIM set the SIM group looks its books up by the
+ * prefixed name, a local book with that UID stands in for the one of the card */
+static ESource *
+get_fake_sim_book(ESourceRegistry *registry, const gchar *name,
+                  GError **error)
+{
+  gchar *uid = g_strconcat(OSSO_ABOOK_FAKE_SIM_UID_PREFIX, name, NULL);
+  ESource *source = e_source_registry_ref_source(registry, uid);
+  ESourceResource *resource;
+
+  if (source)
+  {
+    ESourceBackend *backend =
+        e_source_get_extension(source, E_SOURCE_EXTENSION_ADDRESS_BOOK);
+
+    g_free(uid);
+
+    if (!g_strcmp0(e_source_backend_get_backend_name(backend), "local"))
+      return source;
+
+    g_set_error(error, G_IO_ERROR, G_IO_ERROR_EXISTS,
+                "Address book %s is not a local one", name);
+    g_object_unref(source);
+
+    return NULL;
+  }
+
+  source = e_source_new_with_uid(uid, NULL, error);
+  g_free(uid);
+
+  if (!source)
+    return NULL;
+
+  e_source_set_display_name(source, name);
+  resource = e_source_get_extension(source, E_SOURCE_EXTENSION_RESOURCE);
+  e_source_resource_set_identity(resource, name);
+
+  return commit_local_book(registry, source, error);
+}
+
+static gboolean
+clear_book(ESource *source, GError **error)
+{
+  EBookQuery *query = e_book_query_any_field_contains("");
+  gchar *sexp = e_book_query_to_string(query);
+  GSList *uids = NULL;
+  EClient *client;
+  gboolean rv = FALSE;
+
+  e_book_query_unref(query);
+  client = e_book_client_connect_sync(source, 30, NULL, error);
+
+  if (client &&
+      e_book_client_get_contacts_uids_sync(E_BOOK_CLIENT(client), sexp, &uids,
+                                           NULL, error))
+  {
+    rv = !uids ||
+        e_book_client_remove_contacts_sync(E_BOOK_CLIENT(client), uids,
+                                           E_BOOK_OPERATION_FLAG_NONE, NULL,
+                                           error);
+  }
+
+  g_slist_free_full(uids, g_free);
+  g_free(sexp);
+
+  if (client)
+    g_object_unref(client);
+
+  return rv;
+}
+
+static ESource *
+get_book(ESourceRegistry *registry, GError **error)
+{
+  ESource *source;
+
+  if (scratch)
+    return create_scratch_book(registry, error);
+
+  if (!book_uid)
+    return e_source_registry_ref_builtin_address_book(registry);
+
+  source = e_source_registry_ref_source(registry, book_uid);
+
+  if (!source)
+  {
+    g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                "No address book with UID %s", book_uid);
+  }
+
+  return source;
+}
+
+static void
+print_import_stats(import_engine *engine)
+{
+  import_stats stats;
+  gdouble seconds;
+
+  import_engine_get_stats(engine, &stats);
+  seconds = MAX(stats.elapsed / (gdouble)G_USEC_PER_SEC, 0.001);
+
+  g_print("%d cards parsed, %d contacts committed (%d updated), "
+          "%d unchanged\n", stats.parsed_contacts, stats.committed_contacts,
+          stats.updated_contacts, stats.skipped_contacts);
+  g_print("%" G_GUINT64_FORMAT " bytes in %.3f s, %.1f contacts/s, "
+          "%.2f MB/s\n", stats.read_bytes, seconds,
+          stats.parsed_contacts / seconds,
+          stats.read_bytes / seconds / (1024 * 1024));
+}
+
+static void
+print_export_stats(export_engine *engine, int deleted)
+{
+  export_stats stats;
+  gdouble seconds;
+
+  export_engine_get_stats(engine, &stats);
+  seconds = MAX(stats.elapsed / (gdouble)G_USEC_PER_SEC, 0.001);
+
+  g_print("%d contacts exported, %d deleted\n", stats.exported_contacts,
+          deleted);
+  g_print("%" G_GUINT64_FORMAT " bytes in %.3f s, %.1f contacts/s, "
+          "%.2f MB/s\n", stats.written_bytes, seconds,
+          stats.exported_contacts / seconds,
+          stats.written_bytes / seconds / (1024 * 1024));
+}
+
+static int
+run_import(ESource *source, int argc, char **argv)
+{
+  GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+  import_engine *engine;
+  guint sigint_id;
+  int res = 0;
+  int i;
+
+  engine = import_engine_new(source, journal, import_done_cb, loop);
+
+  for (i = 1; i < argc; i++)
+  {
+    GFile *file = g_file_new_for_commandline_arg(argv[i]);
+    gchar *uri = g_file_get_uri(file);
+
+    if (g_file_query_file_type(file, G_FILE_QUERY_INFO_NONE, NULL) ==
+        G_FILE_TYPE_DIRECTORY)
+    {
+      import_engine_add_directory(engine, uri);
+    }
+    else
+      import_engine_add_file(engine, uri);
+
+    g_free(uri);
+    g_object_unref(file);
+  }
+
+  sigint_id = g_unix_signal_add(SIGINT, import_interrupt_cb, engine);
+  import_engine_start(engine);
+  g_main_loop_run(loop);
+  g_source_remove(sigint_id);
+
+  print_import_stats(engine);
+
+  if (import_engine_get_error_message(engine))
+  {
+    g_printerr("%s\n", import_engine_get_error_message(engine));
+    res = 1;
+  }
+
+  import_engine_free(engine);
+  g_main_loop_unref(loop);
+
+  return res;
+}
+
+/* Deleted contacts are listed one UID per line */
+static gboolean
+write_deleted(gchar **uids, GError **error)
+{
+  gchar *path = g_strconcat(export_path, ".deleted", NULL);
+  gchar *contents = g_strjoinv("\n", uids);
+  gboolean rv;
+
+  if (*uids)
+  {
+    gchar *tmp = contents;
+
+    contents = g_strconcat(tmp, "\n", NULL);
+    g_free(tmp);
+  }
+
+  rv = g_file_set_contents(path, contents, -1, error);
+  g_free(contents);
+  g_free(path);
+
+  return rv;
+}
+
+/* A delta export writes only what differs from the previous delta export of
+ * the same book, and records what it wrote as the next checkpoint. Others
+ * leave the checkpoint alone. */
+static int
+run_export(ESource *source)
+{
+  export_checkpoint *checkpoint = NULL;
+  GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+  GFile *file = g_file_new_for_commandline_arg(export_path);
+  EBookQuery *query = e_book_query_any_field_contains("");
+  gchar *sexp = e_book_query_to_string(query);
+  GSList *contacts = NULL;
+  export_engine *engine = NULL;
+  gchar **deleted = NULL;
+  GFileOutputStream *os;
+  GError *error = NULL;
+  EClient *client;
+  guint sigint_id;
+  int res = 1;
+  GSList *l;
+
+  e_book_query_unref(query);
+
+  if (delta)
+    checkpoint = export_checkpoint_load(e_source_get_uid(source));
+
+  client = e_book_client_connect_sync(source, 30, NULL, &error);
+
+  if (!client ||
+      !e_book_client_get_contacts_sync(E_BOOK_CLIENT(client), sexp, &contacts,
+                                       NULL, &error))
+  {
+    g_printerr("Cannot read the address book: %s\n", error->message);
+    goto out;
+  }
+
+  os = g_file_replace(file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, &error);
+
+  if (!os)
+  {
+    g_printerr("Cannot export to %s: %s\n", export_path, error->message);
+    goto out;
+  }
+
+  engine = export_engine_new(G_OUTPUT_STREAM(os), export_done_cb, loop);
+  g_object_unref(os);
+
+  for (l = contacts; l; l = l->next)
+  {
+    if (!delta || export_checkpoint_update(checkpoint, l->data))
+      export_engine_add_contact(engine, l->data);
+  }
+
+  if (delta)
+    deleted = export_checkpoint_get_deleted(checkpoint);
+
+  sigint_id = g_unix_signal_add(SIGINT, export_interrupt_cb, engine);
+  export_engine_start(engine);
+  g_main_loop_run(loop);
+  g_source_remove(sigint_id);
+
+  if (export_engine_get_error(engine))
+  {
+    g_printerr("Cannot export to %s: %s\n", export_path,
+               export_engine_get_error(engine)->message);
+    goto out;
+  }
+
+  /* the checkpoint only moves once the export is safely written */
+  if (delta &&
+      (!write_deleted(deleted, &error) ||
+       !export_checkpoint_save(checkpoint, &error)))
+  {
+    g_printerr("Cannot save the export checkpoint: %s\n", error->message);
+    goto out;
+  }
+
+  print_export_stats(engine, delta ? g_strv_length(deleted) : 0);
+  res = 0;
+
+out:
+  g_clear_error(&error);
+  g_strfreev(deleted);
+  export_engine_free(engine);
+  g_slist_free_full(contacts, g_object_unref);
+
+  if (client)
+    g_object_unref(client);
+
+  g_free(sexp);
+  g_object_unref(file);
+  g_main_loop_unref(loop);
+  export_checkpoint_free(checkpoint);
+
+  return res;
+}
+
+/* Every book of the fake SIM gets emptied, then filled from DIR/<book>.vcf if
+ * there is one, so runs start from the same card */
+static int
+run_fake_sim(ESourceRegistry *registry)
+{
+  const char **book;
+  int res = 0;
+
+  for (book = fake_sim_books; *book && !res; book++)
+  {
+    gchar *name = g_strconcat(*book, ".vcf", NULL);
+    gchar *path = g_build_filename(fake_sim_dir, name, NULL);
+    GError *error = NULL;
+    ESource *source = get_fake_sim_book(registry, *book, &error);
+
+    if (!source || !clear_book(source, &error))
+    {
+      g_printerr("Cannot set up the fake SIM book %s: %s\n", *book,
+                 error->message);
+      g_error_free(error);
+      res = 1;
+    }
+    else if (g_file_test(path, G_FILE_TEST_IS_REGULAR))
+    {
+      char *files[] = { NULL, path };
+
+      g_print("%s:\n", *book);
+      res = run_import(source, G_N_ELEMENTS(files), files);
+    }
+
+    if (source)
+      g_object_unref(source);
+
+    g_free(path);
+    g_free(name);
+  }
+
+  return res;
+}
+
+/* The fake SIM books outlive the run that fills them, as the SIM group reads
+ * them later on, so they are removed only when asked to */
+static int
+run_remove_fake_sim(ESourceRegistry *registry)
+{
+  const char **book;
+  int res = 0;
+
+  for (book = fake_sim_books; *book; book++)
+  {
+    gchar *uid = g_strconcat(OSSO_ABOOK_FAKE_SIM_UID_PREFIX, *book, NULL);
+    ESource *source = e_source_registry_ref_source(registry, uid);
+    GError *error = NULL;
+
+    if (source && !e_source_remove_sync(source, NULL, &error))
+    {
+      g_printerr("Cannot remove the fake SIM book %s: %s\n", *book,
+                 error->message);
+      g_error_free(error);
+      res = 1;
+    }
+
+    if (source)
+      g_object_unref(source);
+
+    g_free(uid);
+  }
+
+  return res;
+}
+
+int
+main(int argc, char **argv)
+{
+  GOptionContext *context;
+  ESourceRegistry *registry;
+  ESource *source;
+  GError *error = NULL;
+  int res;
+
+  setlocale(LC_ALL, "");
+  bindtextdomain("osso-addressbook", "/usr/share/locale");
+  bind_textdomain_codeset("osso-addressbook", "UTF-8");
+  textdomain("osso-addressbook");
+
+  context = g_option_context_new("[FILE|DIRECTORY...]");
+  g_option_context_set_summary(context, "Imports vCard files into an "
+                               "address book, or exports it, and reports the "
+                               "throughput.");
+  g_option_context_add_main_entries(context, entries, NULL);
+
+  if (!g_option_context_parse(context, &argc, &argv, &error) ||
+      (!export_path && !fake_sim_dir && !remove_fake_sim && argc < 2) ||
+      ((export_path || fake_sim_dir || remove_fake_sim) && argc > 1) ||
+      (export_path && fake_sim_dir) ||
+      (remove_fake_sim && (export_path || fake_sim_dir)) ||
+      (delta && !export_path))
+  {
+    if (error)
+    {
+      g_printerr("Usage error: %s\n", error->message);
+      g_error_free(error);
+    }
+    else
+    {
+      gchar *help = g_option_context_get_help(context, TRUE, NULL);
+
+      g_printerr("%s", help);
+      g_free(help);
+    }
+
+    g_option_context_free(context);
+
+    return 2;
+  }
+
+  g_option_context_free(context);
+
+  registry = e_source_registry_new_sync(NULL, &error);
+
+  if (!registry)
+  {
+    g_printerr("Cannot get the source registry: %s\n", error->message);
+    g_error_free(error);
+
+    return 1;
+  }
+
+  if (fake_sim_dir)
+  {
+    res = run_fake_sim(registry);
+    g_object_unref(registry);
+
+    return res;
+  }
+
+  if (remove_fake_sim)
+  {
+    res = run_remove_fake_sim(registry);
+    g_object_unref(registry);
+
+    return res;
+  }
+
+  source = get_book(registry, &error);
+
+  if (!source)
+  {
+    g_printerr("Cannot get the address book: %s\n", error->message);
+    g_error_free(error);
+    g_object_unref(registry);
+
+    return 1;
+  }
+
+  if (export_path)
+    res = run_export(source);
+  else
+    res = run_import(source, argc, argv);
+
+  if (scratch && !e_source_remove_sync(source, NULL, &error))
+  {
+    g_printerr("Cannot remove the scratch address book: %s\n",
+               error->message);
+    g_clear_error(&error);
+  }
+
+  g_object_unref(source);
+  g_object_unref(registry);
+
+  return res;
+}
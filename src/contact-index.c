@@ -0,0 +1,399 @@
+/*
+ * contact-index.c
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+
+#include "contact-index.h"
+
+/* Country and trunk prefixes differ between otherwise identical numbers, only
+ * the subscriber part is compared */
+#define PHONE_MATCH_DIGITS 7
+
+struct _contact_index
+{
+  /* UID -> content hash */
+  GHashTable *hashes;
+
+  /* fingerprint -> UID */
+  GHashTable *uids;
+};
+
+/* Attributes that change when a contact is stored or exported, without the
+ * contact itself being changed */
+static const char *volatile_attributes[] =
+{
+  EVC_UID,
+  EVC_REV,
+  EVC_VERSION,
+  EVC_PHOTO,
+  EVC_LOGO
+};
+
+/* Attributes that identify the stored copy rather than the contact */
+static const char *revision_attributes[] =
+{
+  EVC_UID,
+  EVC_REV
+};
+
+static gint
+compare_strings(gconstpointer a, gconstpointer b)
+{
+  return strcmp(*(const gchar **)a, *(const gchar **)b);
+}
+
+static gboolean
+is_attribute_in(EVCardAttribute *attr, const char **names, guint n_names)
+{
+  const char *name = e_vcard_attribute_get_name(attr);
+  guint i;
+
+  for (i = 0; i < n_names; i++)
+  {
+    if (!g_ascii_strcasecmp(name, names[i]))
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+static gchar *
+serialize_param(EVCardAttributeParam *param)
+{
+  GPtrArray *values = g_ptr_array_new();
+  GString *s = g_string_new(e_vcard_attribute_param_get_name(param));
+  GList *l;
+  guint i;
+
+  g_string_ascii_up(s);
+  g_string_append_c(s, '=');
+
+  for (l = e_vcard_attribute_param_get_values(param); l; l = l->next)
+    g_ptr_array_add(values, l->data);
+
+  g_ptr_array_sort(values, compare_strings);
+
+  for (i = 0; i < values->len; i++)
+  {
+    if (i)
+      g_string_append_c(s, ',');
+
+    g_string_append(s, g_ptr_array_index(values, i));
+  }
+
+  g_ptr_array_free(values, TRUE);
+
+  return g_string_free(s, FALSE);
+}
+
+/* Attribute and parameter order is not significant, neither is the case of
+ * their names */
+static gchar *
+serialize_attribute(EVCardAttribute *attr)
+{
+  GPtrArray *params = g_ptr_array_new_with_free_func(g_free);
+  GString *s = g_string_new(e_vcard_attribute_get_name(attr));
+  GList *l;
+  guint i;
+
+  g_string_ascii_up(s);
+
+  for (l = e_vcard_attribute_get_params(attr); l; l = l->next)
+    g_ptr_array_add(params, serialize_param(l->data));
+
+  g_ptr_array_sort(params, compare_strings);
+
+  for (i = 0; i < params->len; i++)
+  {
+    g_string_append_c(s, ';');
+    g_string_append(s, g_ptr_array_index(params, i));
+  }
+
+  g_ptr_array_free(params, TRUE);
+  g_string_append_c(s, ':');
+
+  for (l = e_vcard_attribute_get_values(attr); l; l = l->next)
+  {
+    if (l != e_vcard_attribute_get_values(attr))
+      g_string_append_c(s, ';');
+
+    if (l->data)
+      g_string_append(s, l->data);
+  }
+
+  return g_string_free(s, FALSE);
+}
+
+static gchar *
+checksum_lines(GPtrArray *lines)
+{
+  GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA1);
+  gchar *rv;
+  guint i;
+
+  g_ptr_array_sort(lines, compare_strings);
+
+  for (i = 0; i < lines->len; i++)
+  {
+    g_checksum_update(checksum, g_ptr_array_index(lines, i), -1);
+    g_checksum_update(checksum, (const guchar *)"\n", 1);
+  }
+
+  rv = g_strdup(g_checksum_get_string(checksum));
+  g_checksum_free(checksum);
+
+  return rv;
+}
+
+static gchar *
+hash_attributes(EContact *contact, const char **skip, guint n_skip)
+{
+  GPtrArray *lines = g_ptr_array_new_with_free_func(g_free);
+  GList *l;
+  gchar *rv;
+
+  for (l = e_vcard_get_attributes(E_VCARD(contact)); l; l = l->next)
+  {
+    if (!is_attribute_in(l->data, skip, n_skip))
+      g_ptr_array_add(lines, serialize_attribute(l->data));
+  }
+
+  rv = checksum_lines(lines);
+  g_ptr_array_free(lines, TRUE);
+
+  return rv;
+}
+
+gchar *
+contact_index_content_hash(EContact *contact)
+{
+  return hash_attributes(contact, volatile_attributes,
+                         G_N_ELEMENTS(volatile_attributes));
+}
+
+gchar *
+contact_index_full_hash(EContact *contact)
+{
+  return hash_attributes(contact, revision_attributes,
+                         G_N_ELEMENTS(revision_attributes));
+}
+
+static gchar *
+normalize_name(const gchar *name)
+{
+  gchar *folded = g_utf8_casefold(name, -1);
+  gchar **words = g_strsplit_set(folded, " \t\r\n", -1);
+  GString *s = g_string_new(NULL);
+  gchar **word;
+
+  for (word = words; *word; word++)
+  {
+    if (!**word)
+      continue;
+
+    if (s->len)
+      g_string_append_c(s, ' ');
+
+    g_string_append(s, *word);
+  }
+
+  g_strfreev(words);
+  g_free(folded);
+
+  return g_string_free(s, FALSE);
+}
+
+/* Hash of the normalised name, phone numbers and e-mail addresses, NULL if the
+ * contact has none of them */
+static gchar *
+fingerprint(EContact *contact)
+{
+  const gchar *name = e_contact_get_const(contact, E_CONTACT_FULL_NAME);
+  GPtrArray *lines = g_ptr_array_new_with_free_func(g_free);
+  GList *l;
+  gchar *rv = NULL;
+
+  for (l = e_vcard_get_attributes(E_VCARD(contact)); l; l = l->next)
+  {
+    EVCardAttribute *attr = l->data;
+    const char *attr_name = e_vcard_attribute_get_name(attr);
+    gchar *value;
+
+    if (!g_ascii_strcasecmp(attr_name, EVC_TEL))
+    {
+      gchar *number;
+
+      value = e_vcard_attribute_get_value(attr);
+      number = value ? contact_index_normalize_phone(value) : NULL;
+      g_free(value);
+
+      if (number && *number)
+        g_ptr_array_add(lines, g_strconcat("T", number, NULL));
+
+      g_free(number);
+    }
+    else if (!g_ascii_strcasecmp(attr_name, EVC_EMAIL))
+    {
+      value = e_vcard_attribute_get_value(attr);
+
+      if (value && *g_strstrip(value))
+      {
+        gchar *email = g_utf8_casefold(value, -1);
+
+        g_ptr_array_add(lines, g_strconcat("E", email, NULL));
+        g_free(email);
+      }
+
+      g_free(value);
+    }
+  }
+
+  if (name && *name)
+  {
+    gchar *normalized = normalize_name(name);
+
+    if (*normalized)
+      g_ptr_array_add(lines, g_strconcat("N", normalized, NULL));
+
+    g_free(normalized);
+  }
+
+  if (lines->len)
+    rv = checksum_lines(lines);
+
+  g_ptr_array_free(lines, TRUE);
+
+  return rv;
+}
+
+contact_index *
+contact_index_new(void)
+{
+  contact_index *index = g_new0(contact_index, 1);
+
+  index->hashes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                        g_free);
+  index->uids = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+  return index;
+}
+
+void
+contact_index_free(contact_index *index)
+{
+  if (!index)
+    return;
+
+  g_hash_table_destroy(index->hashes);
+  g_hash_table_destroy(index->uids);
+  g_free(index);
+}
+
+void
+contact_index_add(contact_index *index, EContact *contact)
+{
+  const gchar *uid;
+  gchar *fp;
+
+  g_return_if_fail(index != NULL);
+  g_return_if_fail(E_IS_CONTACT(contact));
+
+  uid = e_contact_get_const(contact, E_CONTACT_UID);
+
+  if (!uid || !*uid)
+    return;
+
+  g_hash_table_replace(index->hashes, g_strdup(uid),
+                       contact_index_content_hash(contact));
+  fp = fingerprint(contact);
+
+  /* for duplicates already in the book, the first one wins */
+  if (fp && !g_hash_table_lookup(index->uids, fp))
+    g_hash_table_insert(index->uids, fp, g_strdup(uid));
+  else
+    g_free(fp);
+}
+
+contact_index_match
+contact_index_lookup(contact_index *index, EContact *contact,
+                     const gchar **uid)
+{
+  const gchar *contact_uid;
+  gpointer match = NULL;
+  gpointer hash = NULL;
+  contact_index_match rv;
+  gchar *h;
+
+  g_return_val_if_fail(index != NULL, CONTACT_INDEX_NEW);
+  g_return_val_if_fail(E_IS_CONTACT(contact), CONTACT_INDEX_NEW);
+
+  contact_uid = e_contact_get_const(contact, E_CONTACT_UID);
+
+  if (!contact_uid || !*contact_uid ||
+      !g_hash_table_lookup_extended(index->hashes, contact_uid, &match, &hash))
+  {
+    gchar *fp = fingerprint(contact);
+
+    if (fp)
+    {
+      match = g_hash_table_lookup(index->uids, fp);
+      g_free(fp);
+    }
+
+    if (!match)
+      return CONTACT_INDEX_NEW;
+
+    hash = g_hash_table_lookup(index->hashes, match);
+  }
+
+  h = contact_index_content_hash(contact);
+  rv = g_strcmp0(h, hash) ? CONTACT_INDEX_CHANGED : CONTACT_INDEX_IDENTICAL;
+  g_free(h);
+
+  if (uid)
+    *uid = match;
+
+  return rv;
+}
+
+gchar *
+contact_index_normalize_phone(const gchar *number)
+{
+  GString *digits;
+  const gchar *p;
+
+  g_return_val_if_fail(number != NULL, NULL);
+
+  digits = g_string_new(NULL);
+
+  for (p = number; *p; p++)
+  {
+    /* pause and DTMF tones are not part of the number */
+    if (strchr("pPwW,;", *p))
+      break;
+
+    if (g_ascii_isdigit(*p))
+      g_string_append_c(digits, *p);
+  }
+
+  if (digits->len > PHONE_MATCH_DIGITS)
+    g_string_erase(digits, 0, digits->len - PHONE_MATCH_DIGITS);
+
+  return g_string_free(digits, FALSE);
+}
@@ -0,0 +1,64 @@
+/*
+ * contact-index.h
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CONTACT_INDEX_H
+#define CONTACT_INDEX_H
+
+#include <libebook/libebook.h>
+
+typedef enum
+{
+  CONTACT_INDEX_NEW,
+  CONTACT_INDEX_IDENTICAL,
+  CONTACT_INDEX_CHANGED
+} contact_index_match;
+
+typedef struct _contact_index contact_index;
+
+contact_index *
+contact_index_new(void);
+
+void
+contact_index_free(contact_index *index);
+
+void
+contact_index_add(contact_index *index, EContact *contact);
+
+/* Looks up an incoming contact, by UID first and by name, phone numbers and
+ * e-mail addresses next. For CONTACT_INDEX_CHANGED *uid is set to the UID of
+ * the matching contact. Lookups can run from several threads at once, as long
+ * as nothing is added meanwhile. */
+contact_index_match
+contact_index_lookup(contact_index *index, EContact *contact,
+                     const gchar **uid);
+
+gchar *
+contact_index_normalize_phone(const gchar *number);
+
+/* SHA1 over the attributes of contact, in no particular order and without the
+ * ones that change on every store or export */
+gchar *
+contact_index_content_hash(EContact *contact);
+
+/* Same, but only UID and REV are left out, so a new photo counts as a
+ * change */
+gchar *
+contact_index_full_hash(EContact *contact);
+
+#endif // CONTACT_INDEX_H
@@ -0,0 +1,234 @@
+/*
+ * export-checkpoint.c
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <glib/gstdio.h>
+
+#include <libosso-abook/osso-abook-log.h>
+
+#include <string.h>
+
+#include "contact-index.h"
+#include "export-checkpoint.h"
+
+typedef struct
+{
+  gchar *rev;
+  gchar *hash;
+} checkpoint_entry;
+
+struct _export_checkpoint
+{
+  gchar *path;
+
+  /* UID -> checkpoint_entry, as saved and as seen since */
+  GHashTable *saved;
+  GHashTable *seen;
+};
+
+static void
+checkpoint_entry_free(checkpoint_entry *entry)
+{
+  g_free(entry->rev);
+  g_free(entry->hash);
+  g_free(entry);
+}
+
+static checkpoint_entry *
+checkpoint_entry_new(const gchar *rev, const gchar *hash)
+{
+  checkpoint_entry *entry = g_new(checkpoint_entry, 1);
+
+  entry->rev = g_strdup(rev);
+  entry->hash = g_strdup(hash);
+
+  return entry;
+}
+
+static GHashTable *
+checkpoint_table_new()
+{
+  return g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                               (GDestroyNotify)checkpoint_entry_free);
+}
+
+/* One contact per line, as UID, REV and content hash separated by tabs */
+export_checkpoint *
+export_checkpoint_load(const gchar *book_uid)
+{
+  export_checkpoint *checkpoint;
+  GError *error = NULL;
+  gchar *contents;
+  gchar *name;
+
+  g_return_val_if_fail(book_uid != NULL, NULL);
+
+  name = g_strconcat("export-checkpoint-", book_uid, NULL);
+  e_filename_make_safe(name);
+
+  checkpoint = g_new0(export_checkpoint, 1);
+  checkpoint->path = g_build_filename(g_get_home_dir(), ".osso-abook", name,
+                                      NULL);
+  g_free(name);
+  checkpoint->saved = checkpoint_table_new();
+  checkpoint->seen = checkpoint_table_new();
+
+  if (g_file_get_contents(checkpoint->path, &contents, NULL, &error))
+  {
+    gchar **lines = g_strsplit(contents, "\n", -1);
+    gchar **line;
+
+    for (line = lines; *line; line++)
+    {
+      gchar **fields = g_strsplit(*line, "\t", 3);
+
+      if (g_strv_length(fields) == 3)
+      {
+        g_hash_table_replace(checkpoint->saved, g_strdup(fields[0]),
+                             checkpoint_entry_new(fields[1], fields[2]));
+      }
+
+      g_strfreev(fields);
+    }
+
+    g_strfreev(lines);
+    g_free(contents);
+  }
+  else
+  {
+    if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+    {
+      OSSO_ABOOK_WARN("Cannot load export checkpoint %s: %s",
+                      checkpoint->path, error->message);
+    }
+
+    g_error_free(error);
+  }
+
+  return checkpoint;
+}
+
+void
+export_checkpoint_free(export_checkpoint *checkpoint)
+{
+  if (!checkpoint)
+    return;
+
+  g_hash_table_destroy(checkpoint->saved);
+  g_hash_table_destroy(checkpoint->seen);
+  g_free(checkpoint->path);
+  g_free(checkpoint);
+}
+
+/* The content is only hashed if the revision changed, most contacts don't */
+gboolean
+export_checkpoint_update(export_checkpoint *checkpoint, EContact *contact)
+{
+  const gchar *uid;
+  const gchar *rev;
+  checkpoint_entry *saved;
+  gchar *hash;
+  gboolean changed;
+
+  g_return_val_if_fail(checkpoint != NULL, TRUE);
+  g_return_val_if_fail(E_IS_CONTACT(contact), TRUE);
+
+  uid = e_contact_get_const(contact, E_CONTACT_UID);
+
+  if (!uid || !*uid || strchr(uid, '\t') || strchr(uid, '\n'))
+    return TRUE;
+
+  rev = e_contact_get_const(contact, E_CONTACT_REV);
+  saved = g_hash_table_lookup(checkpoint->saved, uid);
+
+  if (!rev || strchr(rev, '\t') || strchr(rev, '\n'))
+    rev = "";
+
+  if (saved && *rev && !strcmp(saved->rev, rev))
+  {
+    g_hash_table_replace(checkpoint->seen, g_strdup(uid),
+                         checkpoint_entry_new(saved->rev, saved->hash));
+
+    return FALSE;
+  }
+
+  hash = contact_index_full_hash(contact);
+  changed = !saved || strcmp(saved->hash, hash);
+  g_hash_table_replace(checkpoint->seen, g_strdup(uid),
+                       checkpoint_entry_new(rev, hash));
+  g_free(hash);
+
+  return changed;
+}
+
+gchar **
+export_checkpoint_get_deleted(export_checkpoint *checkpoint)
+{
+  GPtrArray *uids;
+  GHashTableIter iter;
+  gpointer uid;
+
+  g_return_val_if_fail(checkpoint != NULL, NULL);
+
+  uids = g_ptr_array_new();
+  g_hash_table_iter_init(&iter, checkpoint->saved);
+
+  while (g_hash_table_iter_next(&iter, &uid, NULL))
+  {
+    if (!g_hash_table_contains(checkpoint->seen, uid))
+      g_ptr_array_add(uids, g_strdup(uid));
+  }
+
+  g_ptr_array_add(uids, NULL);
+
+  return (gchar **)g_ptr_array_free(uids, FALSE);
+}
+
+gboolean
+export_checkpoint_save(export_checkpoint *checkpoint, GError **error)
+{
+  GString *contents;
+  GHashTableIter iter;
+  gpointer uid;
+  gpointer value;
+  gchar *dir;
+  gboolean rv;
+
+  g_return_val_if_fail(checkpoint != NULL, FALSE);
+
+  contents = g_string_new(NULL);
+  g_hash_table_iter_init(&iter, checkpoint->seen);
+
+  while (g_hash_table_iter_next(&iter, &uid, &value))
+  {
+    checkpoint_entry *entry = value;
+
+    g_string_append_printf(contents, "%s\t%s\t%s\n", (const gchar *)uid,
+                           entry->rev, entry->hash);
+  }
+
+  dir = g_path_get_dirname(checkpoint->path);
+  g_mkdir_with_parents(dir, 0755);
+  g_free(dir);
+
+  rv = g_file_set_contents(checkpoint->path, contents->str, contents->len,
+                           error);
+  g_string_free(contents, TRUE);
+
+  return rv;
+}
@@ -0,0 +1,49 @@
+/*
+ * export-checkpoint.h
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef EXPORT_CHECKPOINT_H
+#define EXPORT_CHECKPOINT_H
+
+#include <libebook-contacts/libebook-contacts.h>
+
+/* What the last export of a book wrote, as the revision and the content hash
+ * of every contact. Contacts are compared against it, and what they are
+ * compared with becomes the next checkpoint once saved. */
+typedef struct _export_checkpoint export_checkpoint;
+
+/* every book has a checkpoint of its own, book_uid is its source UID */
+export_checkpoint *
+export_checkpoint_load(const gchar *book_uid);
+
+void
+export_checkpoint_free(export_checkpoint *checkpoint);
+
+/* TRUE if contact was added or has changed since the checkpoint */
+gboolean
+export_checkpoint_update(export_checkpoint *checkpoint, EContact *contact);
+
+/* UIDs in the checkpoint that were not passed to export_checkpoint_update(),
+ * NULL terminated */
+gchar **
+export_checkpoint_get_deleted(export_checkpoint *checkpoint);
+
+gboolean
+export_checkpoint_save(export_checkpoint *checkpoint, GError **error);
+
+#endif // EXPORT_CHECKPOINT_H
@@ -0,0 +1,522 @@
+/*
+ * export-engine.c
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <libosso-abook/osso-abook-contact.h>
+#include <libosso-abook/osso-abook-log.h>
+
+#include "export-engine.h"
+
+#define CONTACTS_PER_JOB 32
+#define MAX_EXPORT_THREADS 16
+
+/* A plain copy of a contact, nobody but the worker serialising it holds */
+typedef struct
+{
+  EContact *contact;
+  gchar *vcard;
+} export_item;
+
+typedef struct
+{
+  export_engine *engine;
+  guint seq;
+  GPtrArray *contacts;
+  GBytes *vcards;
+} export_job;
+
+/* Contacts are serialised by a pool of worker threads, CONTACTS_PER_JOB at a
+ * time. Finished jobs are written in the order they were queued, one at a
+ * time. At most two jobs per thread are in memory, whatever the number of
+ * contacts. */
+struct _export_engine
+{
+  GOutputStream *os;
+  GQueue contacts;
+  GCancellable *cancellable;
+  export_engine_done_cb cb;
+  gpointer user_data;
+  GError *error;
+
+  GThreadPool *pool;
+  guint max_jobs;
+
+  /* jobs the workers are busy with */
+  guint jobs;
+
+  /* seq -> finished export_job */
+  GHashTable *finished;
+  guint next_seq;
+  guint write_seq;
+  export_job *writing;
+  gboolean closing;
+  gboolean done;
+
+  gint64 start_time;
+  gint64 end_time;
+  int total_contacts;
+  int exported_contacts;
+  guint64 written_bytes;
+};
+
+static void
+export_pump(export_engine *engine);
+
+static void
+export_serialize_func(gpointer data, gpointer user_data);
+
+static gboolean
+export_job_done_cb(gpointer user_data);
+
+static void
+export_item_free(export_item *item)
+{
+  if (item->contact)
+    g_object_unref(item->contact);
+
+  g_free(item->vcard);
+  g_free(item);
+}
+
+static void
+export_job_free(export_job *job)
+{
+  g_ptr_array_free(job->contacts, TRUE);
+
+  if (job->vcards)
+    g_bytes_unref(job->vcards);
+
+  g_free(job);
+}
+
+export_engine *
+export_engine_new(GOutputStream *os, export_engine_done_cb cb,
+                  gpointer user_data)
+{
+  export_engine *engine;
+  guint threads;
+
+  g_return_val_if_fail(G_IS_OUTPUT_STREAM(os), NULL);
+
+  threads = CLAMP(g_get_num_processors(), 1, MAX_EXPORT_THREADS);
+  engine = g_new0(export_engine, 1);
+  engine->os = g_object_ref(os);
+  engine->cb = cb;
+  engine->user_data = user_data;
+  engine->cancellable = g_cancellable_new();
+  engine->pool = g_thread_pool_new(export_serialize_func, NULL, threads,
+                                   FALSE, NULL);
+  engine->max_jobs = threads * 2;
+  engine->finished = g_hash_table_new_full(
+      g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)export_job_free);
+  g_queue_init(&engine->contacts);
+
+  return engine;
+}
+
+void
+export_engine_free(export_engine *engine)
+{
+  if (!engine)
+    return;
+
+  /* nothing is queued once we get here, just wait for the threads to exit */
+  g_thread_pool_free(engine->pool, FALSE, TRUE);
+  g_hash_table_destroy(engine->finished);
+
+  if (engine->writing)
+    export_job_free(engine->writing);
+
+  g_queue_foreach(&engine->contacts, (GFunc)g_object_unref, NULL);
+  g_queue_clear(&engine->contacts);
+  g_clear_error(&engine->error);
+  g_object_unref(engine->cancellable);
+  g_object_unref(engine->os);
+  g_free(engine);
+}
+
+void
+export_engine_add_contact(export_engine *engine, EContact *contact)
+{
+  g_return_if_fail(engine != NULL);
+  g_return_if_fail(E_IS_CONTACT(contact));
+
+  g_queue_push_tail(&engine->contacts, g_object_ref(contact));
+  engine->total_contacts++;
+}
+
+void
+export_engine_cancel(export_engine *engine)
+{
+  g_return_if_fail(engine != NULL);
+
+  g_cancellable_cancel(engine->cancellable);
+}
+
+gdouble
+export_engine_get_progress(export_engine *engine)
+{
+  g_return_val_if_fail(engine != NULL, 0.0);
+
+  if (!engine->total_contacts)
+    return 0.0;
+
+  return (gdouble)engine->exported_contacts / engine->total_contacts;
+}
+
+void
+export_engine_get_stats(export_engine *engine, export_stats *stats)
+{
+  g_return_if_fail(engine != NULL);
+  g_return_if_fail(stats != NULL);
+
+  stats->elapsed = (engine->end_time ? engine->end_time :
+                    g_get_monotonic_time()) - engine->start_time;
+  stats->total_contacts = engine->total_contacts;
+  stats->exported_contacts = engine->exported_contacts;
+  stats->written_bytes = engine->written_bytes;
+}
+
+const GError *
+export_engine_get_error(export_engine *engine)
+{
+  g_return_val_if_fail(engine != NULL, NULL);
+
+  return engine->error;
+}
+
+/* attributes a card has one of at most, those of the master contact win */
+static gboolean
+export_is_single_attribute(const gchar *name)
+{
+  static const gchar *names[] =
+  {
+    EVC_UID, EVC_REV, EVC_VERSION, EVC_N, EVC_FN, EVC_NICKNAME, EVC_PHOTO,
+    NULL
+  };
+  const gchar **n;
+
+  for (n = names; *n; n++)
+  {
+    if (!g_ascii_strcasecmp(*n, name))
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+static gboolean
+export_has_attribute(EVCard *vcard, EVCardAttribute *attr, gboolean by_name)
+{
+  const gchar *name = e_vcard_attribute_get_name(attr);
+  GList *l;
+
+  for (l = e_vcard_get_attributes(vcard); l; l = l->next)
+  {
+    GList *v = e_vcard_attribute_get_values(l->data);
+    GList *w = e_vcard_attribute_get_values(attr);
+
+    if (g_ascii_strcasecmp(e_vcard_attribute_get_name(l->data), name))
+      continue;
+
+    if (by_name)
+      return TRUE;
+
+    while (v && w && !g_strcmp0(v->data, w->data))
+    {
+      v = v->next;
+      w = w->next;
+    }
+
+    if (!v && !w)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* Roster contacts add what the master does not have already, their IM
+ * addresses mostly */
+static void
+export_merge_attributes(EVCard *vcard, EVCard *from)
+{
+  GList *l;
+
+  for (l = e_vcard_get_attributes(from); l; l = l->next)
+  {
+    EVCardAttribute *attr = l->data;
+    const gchar *name = e_vcard_attribute_get_name(attr);
+
+    if (!export_has_attribute(vcard, attr, export_is_single_attribute(name)))
+      e_vcard_append_attribute(vcard, e_vcard_attribute_copy(attr));
+  }
+}
+
+/* Master contacts are shared with the aggregator, which keeps changing them,
+ * and the same goes for their roster contacts. So everything is copied here,
+ * on the main thread, and the workers only see contacts nobody else holds. */
+static export_item *
+export_item_new(EContact *contact)
+{
+  export_item *item = g_new0(export_item, 1);
+  GList *l;
+
+  item->contact = e_contact_new();
+
+  for (l = e_vcard_get_attributes(E_VCARD(contact)); l; l = l->next)
+  {
+    e_vcard_append_attribute(E_VCARD(item->contact),
+                             e_vcard_attribute_copy(l->data));
+  }
+
+  if (OSSO_ABOOK_IS_CONTACT(contact))
+  {
+    GList *roster_contacts = osso_abook_contact_get_roster_contacts(
+          OSSO_ABOOK_CONTACT(contact));
+
+    for (l = roster_contacts; l; l = l->next)
+      export_merge_attributes(E_VCARD(item->contact), l->data);
+
+    g_list_free(roster_contacts);
+  }
+
+  return item;
+}
+
+/* An avatar that is a local file goes in the card */
+static void
+export_inline_photo(EContact *contact)
+{
+  EContactPhoto *photo = e_contact_get(contact, E_CONTACT_PHOTO);
+  gchar *path = NULL;
+  gchar *data;
+  gsize len;
+
+  if (photo && photo->type == E_CONTACT_PHOTO_TYPE_URI)
+    path = g_filename_from_uri(photo->data.uri, NULL, NULL);
+
+  if (path && g_file_get_contents(path, &data, &len, NULL))
+  {
+    gchar *content_type = g_content_type_guess(path, (guchar *)data, len,
+                                               NULL);
+    EContactPhoto inlined;
+
+    inlined.type = E_CONTACT_PHOTO_TYPE_INLINED;
+    inlined.data.inlined.mime_type = g_content_type_get_mime_type(
+          content_type);
+    inlined.data.inlined.length = len;
+    inlined.data.inlined.data = (guchar *)data;
+    e_contact_set(contact, E_CONTACT_PHOTO, &inlined);
+
+    g_free(inlined.data.inlined.mime_type);
+    g_free(content_type);
+    g_free(data);
+  }
+
+  if (photo)
+    e_contact_photo_free(photo);
+
+  g_free(path);
+}
+
+static gboolean
+export_done_cb(gpointer user_data)
+{
+  export_engine *engine = user_data;
+
+  if (engine->cb)
+    engine->cb(engine, engine->user_data);
+
+  return FALSE;
+}
+
+static void
+export_close_cb(GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  export_engine *engine = user_data;
+  GError *error = NULL;
+
+  if (!g_output_stream_close_finish(G_OUTPUT_STREAM(source_object), res,
+                                    &error))
+  {
+    /* closing with the cancellable triggered discards a replaced file */
+    if (!engine->error)
+      engine->error = error;
+    else
+      g_error_free(error);
+  }
+
+  engine->done = TRUE;
+  engine->end_time = g_get_monotonic_time();
+
+  OSSO_ABOOK_NOTE(GENERIC, "exported %d/%d contacts, %" G_GUINT64_FORMAT
+                  " bytes, in %.2f s", engine->exported_contacts,
+                  engine->total_contacts, engine->written_bytes,
+                  (engine->end_time - engine->start_time) /
+                  (gdouble)G_USEC_PER_SEC);
+
+  g_idle_add(export_done_cb, engine);
+}
+
+static void
+export_write_cb(GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  export_engine *engine = user_data;
+  gsize written = 0;
+
+  if (!g_output_stream_write_all_finish(G_OUTPUT_STREAM(source_object), res,
+                                        &written, &engine->error))
+  {
+    OSSO_ABOOK_WARN("Cannot export contacts: %s", engine->error->message);
+    g_cancellable_cancel(engine->cancellable);
+  }
+  else
+    engine->exported_contacts += engine->writing->contacts->len;
+
+  engine->written_bytes += written;
+  export_job_free(engine->writing);
+  engine->writing = NULL;
+  export_pump(engine);
+}
+
+static void
+export_serialize_func(gpointer data, gpointer user_data)
+{
+  export_job *job = data;
+  GString *vcards = g_string_new(NULL);
+  gsize len;
+  guint i;
+
+  for (i = 0; i < job->contacts->len &&
+       !g_cancellable_is_cancelled(job->engine->cancellable); i++)
+  {
+    export_item *item = g_ptr_array_index(job->contacts, i);
+
+    export_inline_photo(item->contact);
+    item->vcard = e_vcard_to_string(E_VCARD(item->contact),
+                                    EVC_FORMAT_VCARD_30);
+
+    g_string_append(vcards, item->vcard);
+    g_string_append(vcards, "\r\n");
+  }
+
+  len = vcards->len;
+  job->vcards = g_bytes_new_take(g_string_free(vcards, FALSE), len);
+  g_idle_add(export_job_done_cb, job);
+}
+
+static gboolean
+export_job_done_cb(gpointer user_data)
+{
+  export_job *job = user_data;
+  export_engine *engine = job->engine;
+
+  engine->jobs--;
+  g_hash_table_insert(engine->finished, GUINT_TO_POINTER(job->seq), job);
+  export_pump(engine);
+
+  return FALSE;
+}
+
+static void
+export_queue_job(export_engine *engine)
+{
+  export_job *job = g_new0(export_job, 1);
+  EContact *contact;
+
+  job->engine = engine;
+  job->seq = engine->next_seq++;
+  job->contacts =
+      g_ptr_array_new_with_free_func((GDestroyNotify)export_item_free);
+
+  while (job->contacts->len < CONTACTS_PER_JOB &&
+         (contact = g_queue_pop_head(&engine->contacts)))
+  {
+    g_ptr_array_add(job->contacts, export_item_new(contact));
+    g_object_unref(contact);
+  }
+
+  engine->jobs++;
+  g_thread_pool_push(engine->pool, job, NULL);
+}
+
+/* Writes the next job in order if it is done, and keeps the workers busy */
+static void
+export_pump(export_engine *engine)
+{
+  gboolean cancelled = g_cancellable_is_cancelled(engine->cancellable);
+
+  if (engine->closing)
+    return;
+
+  if (cancelled && !engine->error)
+  {
+    g_set_error_literal(&engine->error, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                        "Export cancelled");
+  }
+
+  if (!cancelled)
+  {
+    /* a slow job holds back the ones queued after it, count them too */
+    while (engine->next_seq - engine->write_seq < engine->max_jobs &&
+           !g_queue_is_empty(&engine->contacts))
+    {
+      export_queue_job(engine);
+    }
+  }
+
+  if (engine->writing)
+    return;
+
+  if (!cancelled)
+  {
+    gpointer key = GUINT_TO_POINTER(engine->write_seq);
+    export_job *job = g_hash_table_lookup(engine->finished, key);
+
+    if (job)
+    {
+      g_hash_table_steal(engine->finished, key);
+      engine->write_seq++;
+      engine->writing = job;
+      g_output_stream_write_all_async(
+            engine->os, g_bytes_get_data(job->vcards, NULL),
+            g_bytes_get_size(job->vcards), G_PRIORITY_DEFAULT,
+            engine->cancellable, export_write_cb, engine);
+
+      return;
+    }
+  }
+
+  /* the workers hold on to the engine until their jobs are done */
+  if (!engine->jobs && (cancelled || (g_queue_is_empty(&engine->contacts) &&
+                                      engine->write_seq == engine->next_seq)))
+  {
+    engine->closing = TRUE;
+    g_output_stream_close_async(engine->os, G_PRIORITY_DEFAULT,
+                                engine->cancellable, export_close_cb, engine);
+  }
+}
+
+void
+export_engine_start(export_engine *engine)
+{
+  g_return_if_fail(engine != NULL);
+
+  engine->start_time = g_get_monotonic_time();
+  export_pump(engine);
+}
@@ -0,0 +1,70 @@
+/*
+ * export-engine.h
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef EXPORT_ENGINE_H
+#define EXPORT_ENGINE_H
+
+#include <gio/gio.h>
+#include <libebook-contacts/libebook-contacts.h>
+
+typedef struct _export_engine export_engine;
+
+typedef struct
+{
+  /* in microseconds */
+  gint64 elapsed;
+  int total_contacts;
+  int exported_contacts;
+  guint64 written_bytes;
+} export_stats;
+
+typedef void (*export_engine_done_cb)(export_engine *engine,
+                                      gpointer user_data);
+
+/* Writes vCard 3.0 to os, which gets closed when done */
+export_engine *
+export_engine_new(GOutputStream *os, export_engine_done_cb cb,
+                  gpointer user_data);
+
+void
+export_engine_free(export_engine *engine);
+
+/* Adds a contact to export, contacts are written in the order they are added */
+void
+export_engine_add_contact(export_engine *engine, EContact *contact);
+
+/* cb gets called once everything is written, the export failed or got
+ * cancelled */
+void
+export_engine_start(export_engine *engine);
+
+void
+export_engine_cancel(export_engine *engine);
+
+gdouble
+export_engine_get_progress(export_engine *engine);
+
+void
+export_engine_get_stats(export_engine *engine, export_stats *stats);
+
+/* NULL if the export succeeded */
+const GError *
+export_engine_get_error(export_engine *engine);
+
+#endif // EXPORT_ENGINE_H
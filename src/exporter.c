@@ -0,0 +1,228 @@
+/*
+ * exporter.c
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <hildon/hildon.h>
+#include <hildon/hildon-file-chooser-dialog.h>
+
+#include <libosso-abook/osso-abook-log.h>
+
+#include <libintl.h>
+
+#include "export-engine.h"
+#include "exporter.h"
+
+typedef struct
+{
+  GtkWindow *parent;
+  OssoABookAggregator *aggregator;
+  GFile *file;
+
+  /* a file that was not there before is removed if the export fails */
+  gboolean existed;
+  export_engine *engine;
+  GtkWidget *cancel_note;
+  GtkWidget *progress_bar;
+  guint progress_id;
+} export_data;
+
+static void
+export_data_free(export_data *ed)
+{
+  if (ed->progress_id)
+    g_source_remove(ed->progress_id);
+
+  if (ed->cancel_note)
+    gtk_widget_destroy(ed->cancel_note);
+
+  export_engine_free(ed->engine);
+  g_object_unref(ed->file);
+  g_object_unref(ed->aggregator);
+  g_free(ed);
+}
+
+static void
+cancel_export_response_cb(GtkWidget *dialog, gint response_id,
+                          export_data *ed)
+{
+  if (ed->progress_id)
+  {
+    g_source_remove(ed->progress_id);
+    ed->progress_id = 0;
+  }
+
+  export_engine_cancel(ed->engine);
+  gtk_widget_destroy(ed->cancel_note);
+  ed->progress_bar = NULL;
+  ed->cancel_note = NULL;
+}
+
+static gboolean
+export_progress_update_cb(gpointer user_data)
+{
+  export_data *ed = user_data;
+
+  gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(ed->progress_bar),
+                                export_engine_get_progress(ed->engine));
+
+  return TRUE;
+}
+
+static gboolean
+export_done_idle(gpointer user_data)
+{
+  export_data *ed = user_data;
+  const GError *error = export_engine_get_error(ed->engine);
+
+  if (!error)
+  {
+    hildon_banner_show_information(
+      GTK_WIDGET(ed->parent), NULL,
+      dgettext("hildon-common-strings", "sfil_ib_saved"));
+  }
+  else
+  {
+    if (!ed->existed)
+      g_file_delete(ed->file, NULL, NULL);
+
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      hildon_banner_show_information(
+        GTK_WIDGET(ed->parent), NULL,
+        dgettext("hildon-common-strings", "sfil_ni_operation_failed"));
+    }
+  }
+
+  export_data_free(ed);
+
+  return FALSE;
+}
+
+static void
+export_done_cb(export_engine *engine, gpointer user_data)
+{
+  gdk_threads_add_idle(export_done_idle, user_data);
+}
+
+static void
+export_file_replace_cb(GObject *source_object, GAsyncResult *res,
+                       gpointer user_data)
+{
+  export_data *ed = user_data;
+  GError *error = NULL;
+  GFileOutputStream *os;
+  GList *contacts;
+  GList *l;
+
+  os = g_file_replace_finish(G_FILE(source_object), res, &error);
+
+  if (!os)
+  {
+    OSSO_ABOOK_WARN("Cannot export contacts: %s", error->message);
+    g_error_free(error);
+    hildon_banner_show_information(
+      GTK_WIDGET(ed->parent), NULL,
+      dgettext("hildon-common-strings", "sfil_ni_operation_failed"));
+    export_data_free(ed);
+
+    return;
+  }
+
+  ed->engine = export_engine_new(G_OUTPUT_STREAM(os), export_done_cb, ed);
+  g_object_unref(os);
+  contacts = osso_abook_aggregator_list_master_contacts(ed->aggregator);
+
+  for (l = contacts; l; l = l->next)
+    export_engine_add_contact(ed->engine, l->data);
+
+  g_list_free(contacts);
+
+  ed->progress_bar = gtk_progress_bar_new();
+  ed->cancel_note = hildon_note_new_cancel_with_progress_bar(
+      ed->parent, dgettext(NULL, "addr_me_export"),
+      GTK_PROGRESS_BAR(ed->progress_bar));
+  g_signal_connect(ed->cancel_note, "response",
+                   G_CALLBACK(cancel_export_response_cb), ed);
+  gtk_widget_show(ed->cancel_note);
+  ed->progress_id = gdk_threads_add_timeout_full(
+      G_PRIORITY_HIGH_IDLE, 200, export_progress_update_cb, ed, 0);
+
+  export_engine_start(ed->engine);
+}
+
+static void
+export_file_response_cb(GtkWidget *chooser, gint response_id,
+                        export_data *ed)
+{
+  gchar *uri = NULL;
+
+  if (response_id == GTK_RESPONSE_OK)
+    uri = gtk_file_chooser_get_uri(GTK_FILE_CHOOSER(chooser));
+
+  gtk_widget_destroy(chooser);
+
+  if (!uri)
+  {
+    g_object_unref(ed->aggregator);
+    g_free(ed);
+
+    return;
+  }
+
+  ed->file = g_file_new_for_uri(uri);
+  ed->existed = g_file_query_exists(ed->file, NULL);
+  g_free(uri);
+
+  g_file_replace_async(ed->file, NULL, FALSE, G_FILE_CREATE_NONE,
+                       G_PRIORITY_DEFAULT, NULL, export_file_replace_cb, ed);
+}
+
+void
+do_export(GtkWindow *parent, OssoABookAggregator *aggregator)
+{
+  export_data *ed;
+  GtkWidget *chooser;
+  const gchar *docs_dir;
+  GtkFileFilter *filter;
+
+  g_return_if_fail(OSSO_ABOOK_IS_AGGREGATOR(aggregator));
+
+  ed = g_new0(export_data, 1);
+  ed->parent = parent;
+  ed->aggregator = g_object_ref(aggregator);
+
+  chooser = hildon_file_chooser_dialog_new_with_properties(
+      parent,
+      "title", dgettext(NULL, "addr_me_export"),
+      "action", GTK_FILE_CHOOSER_ACTION_SAVE,
+      NULL);
+  docs_dir = g_get_user_special_dir(G_USER_DIRECTORY_DOCUMENTS);
+
+  if (g_file_test(docs_dir, G_FILE_TEST_IS_DIR))
+    gtk_file_chooser_set_current_folder(GTK_FILE_CHOOSER(chooser), docs_dir);
+
+  gtk_file_chooser_set_current_name(GTK_FILE_CHOOSER(chooser), "contacts.vcf");
+  filter = gtk_file_filter_new();
+  gtk_file_filter_add_pattern(filter, "*.vcf");
+  gtk_file_filter_add_pattern(filter, "*.VCF");
+  gtk_file_chooser_add_filter(GTK_FILE_CHOOSER(chooser), filter);
+  gtk_file_chooser_set_filter(GTK_FILE_CHOOSER(chooser), filter);
+  g_signal_connect(chooser, "response",
+                   G_CALLBACK(export_file_response_cb), ed);
+  gtk_widget_show(chooser);
+}
@@ -0,0 +1,29 @@
+/*
+ * exporter.h
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <libosso-abook/osso-abook-aggregator.h>
+
+/* Asks where to and exports all the master contacts of aggregator */
+void
+do_export(GtkWindow *parent, OssoABookAggregator *aggregator);
+
+#endif // EXPORTER_H
@@ -0,0 +1,1571 @@
+/*
+ * import-engine.c
+ *
+ * Copyright (C) 2021 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gio/gio.h>
+
+#include <libebook/libebook.h>
+#include <libosso-abook/osso-abook-debug.h>
+#include <libosso-abook/osso-abook-log.h>
+#include <libosso-abook/osso-abook-settings.h>
+#include <libosso-abook/osso-abook-util.h>
+
+#include <libintl.h>
+#include <string.h>
+
+#include "contact-index.h"
+#include "import-engine.h"
+#include "import-journal.h"
+#include "vcard-tokenizer.h"
+
+#define FILES_PER_BATCH 20
+#define CONTACTS_PER_BATCH 200
+#define MAX_CONTACTS_PER_BATCH 1000
+
+#define READ_CHUNK_SIZE 65536
+#define MAX_PENDING_CHUNKS 4
+#define MAX_PARALLEL_FILES 16
+
+/* in KiB */
+#define IMPORT_MEMORY_BUDGET 2048
+#define MIN_IMPORT_MEMORY_BUDGET 256
+
+typedef enum
+{
+  IMPORT_FILE_UNKNOWN,
+  IMPORT_FILE_VCARD,
+  IMPORT_FILE_OTHER
+} import_file_type;
+
+typedef struct
+{
+  import_file_type type;
+  goffset size;
+
+  /* the directory the file was found in */
+  const gchar *parent;
+} import_file_class;
+
+/* Contacts of a parsed chunk that are not committed yet. The file is committed
+ * up to offset once none are left. */
+typedef struct
+{
+  guint64 offset;
+  int pending;
+} import_mark;
+
+/* Journal state of a file, outlives the import_source. Chunks are committed
+ * out of order, the journaled offset only moves over a prefix of marks that
+ * have nothing pending. */
+typedef struct
+{
+  gchar *uri;
+  const gchar *parent;
+  guint64 size;
+  guint64 committed;
+  GQueue marks;
+  gboolean parsed;
+} import_file_journal;
+
+typedef struct _import_source import_source;
+
+struct _import_engine
+{
+  ESource *book_source;
+  GList *files;
+
+  /* directories still to be listed, and all of them */
+  GList *dirs;
+  GSList *dir_uris;
+
+  /* GFile -> import_file_class, for files the enumerator already classified */
+  GHashTable *file_types;
+  GList *sources;
+  guint parallel_files;
+  GThreadPool *parser_pool;
+  GCancellable *cancellable;
+  import_engine_done_cb cb;
+  gpointer user_data;
+  const gchar *error_message;
+  contact_index *index;
+
+  /* contacts to add and contacts to update */
+  GQueue contacts;
+  GQueue updates;
+  GSList *batch;
+  GSList *retry;
+  gboolean batch_modify;
+  int batch_size;
+  gboolean committing;
+  gboolean commit_failed;
+  gboolean flush;
+  gboolean done;
+
+  /* vCard bytes held in memory, waiting to be parsed or committed */
+  gsize memory_budget;
+  gsize chunks_bytes;
+  gsize contacts_bytes;
+  gsize batch_bytes;
+  EBookClient *client;
+  EBookStatus status;
+  int imported_contacts;
+
+  /* progress, file sizes are replaced by the bytes actually parsed once a file
+   * is done */
+  gint64 start_time;
+  gint64 end_time;
+  gint64 total_bytes;
+  guint64 read_bytes;
+  guint64 parsed_bytes;
+  int processed_contacts;
+  int committed_contacts;
+  int updated_contacts;
+  int skipped_contacts;
+
+  /* where to resume from if we die half way, NULL if not journaling */
+  import_journal *journal;
+  GList *journal_files;
+};
+
+/* A file being read. Chunks are read asynchronously on the main loop and
+ * queued, the parser thread turns them into contacts one chunk at a time. At
+ * most MAX_PENDING_CHUNKS are queued, and neither reading nor parsing goes on
+ * while the memory budget is used up by contacts waiting to be committed. */
+struct _import_source
+{
+  import_engine *engine;
+  GFile *file;
+  const gchar *parent;
+  GInputStream *is;
+
+  /* only touched by the parser thread */
+  vcard_tokenizer *tokenizer;
+
+  GQueue chunks;
+  gboolean reading : 1;
+  gboolean parsing : 1;
+  gboolean eof : 1;
+  gboolean parsed : 1;
+  gboolean stop : 1;
+  gboolean closing : 1;
+  gboolean bad_format : 1;
+  /* sniffed from a directory listing and not a vCard */
+  gboolean skipped : 1;
+  int contacts;
+
+  /* -1 if not counted in total_bytes */
+  goffset size;
+  guint64 parsed_bytes;
+
+  /* where reading started, non-zero when resuming */
+  guint64 base_offset;
+  import_file_journal *journal;
+  GError *error;
+};
+
+typedef struct
+{
+  import_source *source;
+
+  /* NULL once the end of the file is reached */
+  GBytes *chunk;
+  GQueue contacts;
+  GQueue updates;
+  int skipped;
+  gsize bytes;
+  gboolean too_big;
+
+  /* file offset past the last card parsed */
+  guint64 offset;
+} import_parse_job;
+
+static void
+import_commit_next(import_engine *engine);
+
+static void
+import_parse_func(gpointer data, gpointer user_data);
+
+static gboolean
+import_parse_done_cb(gpointer user_data);
+
+static void
+import_source_pump(import_source *source);
+
+static void
+import_open_files(import_engine *engine);
+
+static void
+import_list_next_dir(import_engine *engine);
+
+/* The number of contacts is not known until everything is parsed, so it is
+ * projected from the share of bytes parsed so far */
+gdouble
+import_engine_get_progress(import_engine *engine)
+{
+  gdouble parsed;
+
+  g_return_val_if_fail(engine != NULL, 0.0);
+
+  if (engine->total_bytes <= 0 || !engine->imported_contacts)
+    return 0.0;
+
+  parsed = MIN((gdouble)engine->parsed_bytes / engine->total_bytes, 1.0);
+
+  return MIN(engine->processed_contacts * parsed / engine->imported_contacts,
+             1.0);
+}
+
+void
+import_engine_get_stats(import_engine *engine, import_stats *stats)
+{
+  g_return_if_fail(engine != NULL);
+  g_return_if_fail(stats != NULL);
+
+  stats->elapsed = (engine->end_time ? engine->end_time :
+                    g_get_monotonic_time()) - engine->start_time;
+  stats->total_bytes = engine->total_bytes;
+  stats->read_bytes = engine->read_bytes;
+  stats->parsed_bytes = engine->parsed_bytes;
+  stats->parsed_contacts = engine->imported_contacts;
+  stats->committed_contacts = engine->committed_contacts;
+  stats->updated_contacts = engine->updated_contacts;
+  stats->skipped_contacts = engine->skipped_contacts;
+}
+
+const gchar *
+import_engine_get_error_message(import_engine *engine)
+{
+  g_return_val_if_fail(engine != NULL, NULL);
+
+  return engine->error_message;
+}
+
+static void
+import_log_throughput(import_engine *engine)
+{
+  gdouble seconds;
+
+  if (!OSSO_ABOOK_DEBUG_FLAGS(CONTACT_ADD))
+    return;
+
+  seconds = (g_get_monotonic_time() - engine->start_time) /
+    (gdouble)G_USEC_PER_SEC;
+  seconds = MAX(seconds, 0.001);
+
+  OSSO_ABOOK_NOTE(CONTACT_ADD,
+                  "%" G_GUINT64_FORMAT "/%" G_GINT64_FORMAT " bytes read, "
+                  "%d cards parsed, %d contacts committed (%d updated), "
+                  "%d unchanged, %.1f contacts/s, %.2f MB/s",
+                  engine->read_bytes, engine->total_bytes,
+                  engine->imported_contacts, engine->committed_contacts,
+                  engine->updated_contacts, engine->skipped_contacts,
+                  engine->committed_contacts / seconds,
+                  engine->read_bytes / seconds / (1024 * 1024));
+}
+
+static int
+import_get_batch_size()
+{
+  GConfValue *val = gconf_client_get(osso_abook_get_gconf_client(),
+                                     "/apps/osso-addressbook/import-batch-size",
+                                     NULL);
+  int batch_size = CONTACTS_PER_BATCH;
+
+  if (val)
+  {
+    batch_size = CLAMP(gconf_value_get_int(val), 1, MAX_CONTACTS_PER_BATCH);
+    gconf_value_free(val);
+  }
+
+  return batch_size;
+}
+
+static int
+import_get_memory_budget()
+{
+  GConfValue *val = gconf_client_get(
+      osso_abook_get_gconf_client(),
+      "/apps/osso-addressbook/import-memory-budget", NULL);
+  int budget = IMPORT_MEMORY_BUDGET;
+
+  if (val)
+  {
+    budget = MAX(gconf_value_get_int(val), MIN_IMPORT_MEMORY_BUDGET);
+    gconf_value_free(val);
+  }
+
+  return budget;
+}
+
+static int
+import_get_parallel_files()
+{
+  GConfValue *val = gconf_client_get(
+      osso_abook_get_gconf_client(),
+      "/apps/osso-addressbook/import-parallel-files", NULL);
+  int files = 0;
+
+  if (val)
+  {
+    files = CLAMP(gconf_value_get_int(val), 0, MAX_PARALLEL_FILES);
+    gconf_value_free(val);
+  }
+
+  if (!files)
+    files = CLAMP(g_get_num_processors(), 1, MAX_PARALLEL_FILES);
+
+  return files;
+}
+
+/* Parsed contacts take more memory than their vCards do, but the vCard size is
+ * good enough to keep the import bounded */
+static gboolean
+import_over_budget(import_engine *engine)
+{
+  return engine->chunks_bytes + engine->contacts_bytes + engine->batch_bytes >=
+         engine->memory_budget;
+}
+
+import_engine *
+import_engine_new(ESource *source, gboolean journal, import_engine_done_cb cb,
+                  gpointer user_data)
+{
+  import_engine *engine;
+
+  g_return_val_if_fail(E_IS_SOURCE(source), NULL);
+
+  engine = g_new0(import_engine, 1);
+  engine->book_source = g_object_ref(source);
+  engine->cb = cb;
+  engine->user_data = user_data;
+  engine->status = E_BOOK_ERROR_OK;
+  engine->batch_size = import_get_batch_size();
+  engine->memory_budget = (gsize)import_get_memory_budget() * 1024;
+  g_queue_init(&engine->contacts);
+  g_queue_init(&engine->updates);
+  engine->cancellable = g_cancellable_new();
+  engine->file_types = g_hash_table_new_full(
+      (GHashFunc)g_file_hash, (GEqualFunc)g_file_equal, g_object_unref,
+      g_free);
+  engine->parallel_files = import_get_parallel_files();
+  engine->parser_pool = g_thread_pool_new(import_parse_func, NULL,
+                                          engine->parallel_files, FALSE, NULL);
+
+  if (journal)
+    engine->journal = import_journal_open();
+
+  return engine;
+}
+
+static void
+import_source_drop_chunks(import_source *source);
+
+static void
+import_source_free(import_source *source)
+{
+  import_source_drop_chunks(source);
+  vcard_tokenizer_free(source->tokenizer);
+
+  if (source->is)
+    g_object_unref(source->is);
+
+  g_object_unref(source->file);
+  g_clear_error(&source->error);
+  g_free(source);
+}
+
+static void
+import_file_journal_free(import_file_journal *jf)
+{
+  g_queue_foreach(&jf->marks, (GFunc)g_free, NULL);
+  g_queue_clear(&jf->marks);
+  g_free(jf->uri);
+  g_free(jf);
+}
+
+static void
+import_mark_done(EContact *contact)
+{
+  import_mark *mark = g_object_get_data(G_OBJECT(contact), "import-mark");
+
+  if (mark)
+    mark->pending--;
+}
+
+/* Moves the journaled offset of every file past the contacts committed so far,
+ * and forgets about files that are completely committed */
+static void
+import_journal_commit(import_engine *engine)
+{
+  GList *l = engine->journal_files;
+
+  if (!engine->journal)
+    return;
+
+  while (l)
+  {
+    import_file_journal *jf = l->data;
+    GList *next = l->next;
+    gboolean advanced = FALSE;
+    import_mark *mark;
+
+    while ((mark = g_queue_peek_head(&jf->marks)) && !mark->pending)
+    {
+      jf->committed = mark->offset;
+      g_free(g_queue_pop_head(&jf->marks));
+      advanced = TRUE;
+    }
+
+    if (jf->parsed && g_queue_is_empty(&jf->marks))
+    {
+      import_journal_remove(engine->journal, jf->uri);
+      import_file_journal_free(jf);
+      engine->journal_files = g_list_delete_link(engine->journal_files, l);
+    }
+    else if (advanced)
+    {
+      import_journal_update(engine->journal, jf->uri,
+                            e_source_get_uid(engine->book_source), jf->parent,
+                            jf->size, jf->committed);
+    }
+
+    l = next;
+  }
+
+  import_journal_sync(engine->journal);
+}
+
+/* An import that ran out of space can be resumed later, its journal stays at
+ * the last contact stored. Anything else that gets here is either done or was
+ * cancelled. */
+static void
+import_journal_finish(import_engine *engine)
+{
+  GSList *s;
+  GList *l;
+
+  if (!engine->journal)
+    return;
+
+  if (engine->commit_failed)
+    import_journal_sync(engine->journal);
+  else
+  {
+    for (l = engine->journal_files; l; l = l->next)
+    {
+      import_journal_remove(engine->journal,
+                            ((import_file_journal *)l->data)->uri);
+    }
+
+    for (s = engine->dir_uris; s; s = s->next)
+      import_journal_remove(engine->journal, s->data);
+
+    import_journal_sync(engine->journal);
+  }
+
+  g_list_free_full(engine->journal_files,
+                   (GDestroyNotify)import_file_journal_free);
+  engine->journal_files = NULL;
+}
+
+void
+import_engine_free(import_engine *engine)
+{
+  if (!engine)
+    return;
+
+  g_list_free_full(engine->sources, (GDestroyNotify)import_source_free);
+
+  /* nothing is queued once we get here, just wait for the thread to exit */
+  g_thread_pool_free(engine->parser_pool, FALSE, TRUE);
+  g_object_unref(engine->cancellable);
+
+  g_list_free_full(engine->files, g_object_unref);
+  g_list_free_full(engine->dirs, g_object_unref);
+  g_hash_table_destroy(engine->file_types);
+  g_queue_foreach(&engine->contacts, (GFunc)g_object_unref, NULL);
+  g_queue_clear(&engine->contacts);
+  g_queue_foreach(&engine->updates, (GFunc)g_object_unref, NULL);
+  g_queue_clear(&engine->updates);
+  contact_index_free(engine->index);
+
+  g_slist_free_full(engine->batch, g_object_unref);
+  g_slist_free_full(engine->retry, g_object_unref);
+
+  import_journal_free(engine->journal);
+  g_slist_free_full(engine->dir_uris, g_free);
+
+  if (engine->client)
+    g_object_unref(engine->client);
+
+  g_object_unref(engine->book_source);
+  g_free(engine);
+}
+
+void
+import_engine_cancel(import_engine *engine)
+{
+  g_return_if_fail(engine != NULL);
+
+  g_cancellable_cancel(engine->cancellable);
+}
+
+static gboolean
+import_done_cb(gpointer user_data)
+{
+  import_engine *engine = user_data;
+
+  if (engine->cb)
+    engine->cb(engine, engine->user_data);
+
+  return FALSE;
+}
+
+static void
+import_finish(import_engine *engine)
+{
+  if (engine->done)
+    return;
+
+  engine->done = TRUE;
+  engine->end_time = g_get_monotonic_time();
+
+  if (!engine->error_message &&
+      (!engine->imported_contacts || engine->status != E_BOOK_ERROR_OK))
+  {
+    engine->error_message = dgettext(NULL, "addr_ni_importing_fail");
+  }
+
+  import_log_throughput(engine);
+  import_journal_finish(engine);
+  g_idle_add(import_done_cb, engine);
+}
+
+static void
+import_set_commit_error(import_engine *engine, const GError *error)
+{
+  if (g_error_matches(error, E_BOOK_CLIENT_ERROR,
+                      E_BOOK_CLIENT_ERROR_NO_SPACE))
+  {
+    engine->status = E_BOOK_ERROR_NO_SPACE;
+    engine->error_message = dgettext(NULL, "addr_ni_importing_fail_mem");
+    engine->commit_failed = TRUE;
+  }
+  else
+    engine->status = E_BOOK_ERROR_OTHER_ERROR;
+}
+
+static void
+commit_contact_cb(GObject *source_object, GAsyncResult *res,
+                  gpointer user_data)
+{
+  import_engine *engine = user_data;
+  EContact *contact = engine->retry->data;
+  GError *error = NULL;
+  gboolean no_space = FALSE;
+  gboolean committed;
+
+  if (engine->batch_modify)
+  {
+    committed = e_book_client_modify_contact_finish(
+        E_BOOK_CLIENT(source_object), res, &error);
+  }
+  else
+  {
+    committed = e_book_client_add_contact_finish(
+        E_BOOK_CLIENT(source_object), res, NULL, &error);
+  }
+
+  if (!committed)
+  {
+    OSSO_ABOOK_WARN("Cannot import contact %s: %s",
+                    (const char *)e_contact_get_const(contact,
+                                                      E_CONTACT_FULL_NAME),
+                    error->message);
+    no_space = g_error_matches(error, E_BOOK_CLIENT_ERROR,
+                               E_BOOK_CLIENT_ERROR_NO_SPACE);
+    import_set_commit_error(engine, error);
+    g_error_free(error);
+  }
+  else
+  {
+    engine->committed_contacts++;
+
+    if (engine->batch_modify)
+      engine->updated_contacts++;
+  }
+
+  engine->processed_contacts++;
+
+  /* one the book rejects is done with, one that did not fit is not */
+  if (!no_space)
+    import_mark_done(contact);
+
+  g_object_unref(contact);
+  engine->retry = g_slist_delete_link(engine->retry, engine->retry);
+
+  if (!engine->retry)
+  {
+    engine->batch_bytes = 0;
+
+    if (!no_space)
+      import_journal_commit(engine);
+  }
+
+  engine->committing = FALSE;
+  import_commit_next(engine);
+}
+
+static void
+commit_contacts_cb(GObject *source_object, GAsyncResult *res,
+                   gpointer user_data)
+{
+  import_engine *engine = user_data;
+  GError *error = NULL;
+  gboolean no_space = FALSE;
+  gboolean committed;
+
+  if (engine->batch_modify)
+  {
+    committed = e_book_client_modify_contacts_finish(
+        E_BOOK_CLIENT(source_object), res, &error);
+  }
+  else
+  {
+    committed = e_book_client_add_contacts_finish(
+        E_BOOK_CLIENT(source_object), res, NULL, &error);
+  }
+
+  if (!committed)
+  {
+    OSSO_ABOOK_WARN("Cannot import batch of %d contacts: %s",
+                    g_slist_length(engine->batch), error->message);
+    no_space = g_error_matches(error, E_BOOK_CLIENT_ERROR,
+                               E_BOOK_CLIENT_ERROR_NO_SPACE);
+
+    /* find out which of the contacts failed, and commit the rest */
+    if (engine->batch->next && !no_space)
+    {
+      engine->retry = engine->batch;
+      engine->batch = NULL;
+    }
+    else
+      import_set_commit_error(engine, error);
+
+    g_error_free(error);
+  }
+
+  if (engine->batch)
+  {
+    int count = g_slist_length(engine->batch);
+
+    if (committed)
+    {
+      engine->committed_contacts += count;
+
+      if (engine->batch_modify)
+        engine->updated_contacts += count;
+    }
+
+    engine->processed_contacts += count;
+    import_log_throughput(engine);
+
+    /* contacts that did not fit are imported again on resume */
+    if (!no_space)
+      g_slist_foreach(engine->batch, (GFunc)import_mark_done, NULL);
+
+    g_slist_free_full(engine->batch, g_object_unref);
+    engine->batch = NULL;
+    engine->batch_bytes = 0;
+
+    if (!no_space)
+      import_journal_commit(engine);
+  }
+
+  engine->committing = FALSE;
+  import_commit_next(engine);
+}
+
+static gboolean
+import_batch_ready(import_engine *engine, GQueue *queue)
+{
+  return !g_queue_is_empty(queue) &&
+         (engine->flush ||
+          g_queue_get_length(queue) >= (guint)engine->batch_size ||
+          import_over_budget(engine));
+}
+
+static void
+import_commit_batch(import_engine *engine, GQueue *queue, gboolean modify)
+{
+  guint queued = engine->contacts.length + engine->updates.length;
+  int i;
+
+  for (i = 0; i < engine->batch_size && !g_queue_is_empty(queue); i++)
+    engine->batch = g_slist_prepend(engine->batch, g_queue_pop_head(queue));
+
+  /* we don't know the size of every single contact, use the average */
+  engine->batch_bytes = engine->contacts_bytes * i / queued;
+  engine->contacts_bytes -= engine->batch_bytes;
+  engine->batch_modify = modify;
+  engine->committing = TRUE;
+
+  if (modify)
+  {
+    OSSO_ABOOK_NOTE(CONTACT_ADD, "updating batch of %d contacts", i);
+
+    e_book_client_modify_contacts(engine->client, engine->batch,
+                                  E_BOOK_OPERATION_FLAG_NONE, NULL,
+                                  commit_contacts_cb, engine);
+  }
+  else
+  {
+    OSSO_ABOOK_NOTE(CONTACT_ADD, "committing batch of %d contacts", i);
+
+    e_book_client_add_contacts(engine->client, engine->batch,
+                               E_BOOK_OPERATION_FLAG_NONE, NULL,
+                               commit_contacts_cb, engine);
+  }
+}
+
+/* Contacts are committed while the files are still being parsed. A batch is
+ * sent as soon as enough contacts are queued, or earlier if the memory budget
+ * is used up. Once flushing, whatever is left is committed and the import
+ * finishes when done. */
+static void
+import_commit_next(import_engine *engine)
+{
+  GList *l;
+
+  if (engine->committing)
+    return;
+
+  if (g_cancellable_is_cancelled(engine->cancellable) || engine->commit_failed)
+  {
+    g_queue_foreach(&engine->contacts, (GFunc)g_object_unref, NULL);
+    g_queue_clear(&engine->contacts);
+    g_queue_foreach(&engine->updates, (GFunc)g_object_unref, NULL);
+    g_queue_clear(&engine->updates);
+    engine->contacts_bytes = 0;
+    g_slist_free_full(engine->retry, g_object_unref);
+    engine->retry = NULL;
+    engine->batch_bytes = 0;
+
+    for (l = engine->sources; l; l = l->next)
+      ((import_source *)l->data)->stop = TRUE;
+  }
+
+  if (engine->retry)
+  {
+    engine->committing = TRUE;
+
+    if (engine->batch_modify)
+    {
+      e_book_client_modify_contact(engine->client, engine->retry->data,
+                                   E_BOOK_OPERATION_FLAG_NONE, NULL,
+                                   commit_contact_cb, engine);
+    }
+    else
+    {
+      e_book_client_add_contact(engine->client, engine->retry->data,
+                                E_BOOK_OPERATION_FLAG_NONE, NULL,
+                                commit_contact_cb, engine);
+    }
+  }
+  else if (import_batch_ready(engine, &engine->contacts))
+    import_commit_batch(engine, &engine->contacts, FALSE);
+  else if (import_batch_ready(engine, &engine->updates))
+    import_commit_batch(engine, &engine->updates, TRUE);
+  else if (engine->flush)
+    import_finish(engine);
+
+  /* committed contacts free some of the budget, keep the parsers going */
+  for (l = engine->sources; l; l = l->next)
+    import_source_pump(l->data);
+}
+
+static void
+import_index_ready_cb(GObject *source_object, GAsyncResult *res,
+                      gpointer user_data)
+{
+  import_engine *engine = user_data;
+
+  engine->index = g_task_propagate_pointer(G_TASK(res), NULL);
+  import_open_files(engine);
+}
+
+static void
+import_index_thread(GTask *task, gpointer source_object, gpointer task_data,
+                    GCancellable *cancellable)
+{
+  contact_index *index = contact_index_new();
+  GSList *l;
+
+  for (l = task_data; l; l = l->next)
+    contact_index_add(index, l->data);
+
+  g_task_return_pointer(task, index, (GDestroyNotify)contact_index_free);
+}
+
+static void
+import_get_contacts_cb(GObject *source_object, GAsyncResult *res,
+                       gpointer user_data)
+{
+  import_engine *engine = user_data;
+  GSList *contacts = NULL;
+  GError *error = NULL;
+
+  if (e_book_client_get_contacts_finish(E_BOOK_CLIENT(source_object), res,
+                                        &contacts, &error))
+  {
+    GTask *task = g_task_new(NULL, NULL, import_index_ready_cb, engine);
+
+    OSSO_ABOOK_NOTE(CONTACT_ADD, "indexing %d existing contacts",
+                    g_slist_length(contacts));
+
+    /* hashing the whole book takes a while, keep it off the main loop */
+    g_task_set_task_data(task, contacts,
+                         (GDestroyNotify)e_client_util_free_object_slist);
+    g_task_run_in_thread(task, import_index_thread);
+    g_object_unref(task);
+  }
+  else
+  {
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      OSSO_ABOOK_WARN("Cannot list existing contacts, duplicates will not be "
+                      "detected: %s", error->message);
+    }
+
+    g_error_free(error);
+    import_open_files(engine);
+  }
+}
+
+static void
+book_client_connect_cb(GObject *source_object, GAsyncResult *res,
+                       gpointer user_data)
+{
+  import_engine *engine = user_data;
+  GError *error = NULL;
+  EClient *client = e_book_client_connect_finish(res, &error);
+
+  if (client)
+  {
+    EBookQuery *query = e_book_query_any_field_contains("");
+    gchar *sexp = e_book_query_to_string(query);
+
+    engine->client = E_BOOK_CLIENT(client);
+    e_book_client_get_contacts(engine->client, sexp, engine->cancellable,
+                               import_get_contacts_cb, engine);
+    g_free(sexp);
+    e_book_query_unref(query);
+  }
+  else
+  {
+    OSSO_ABOOK_WARN("Cannot connect to address book: %s", error->message);
+    g_error_free(error);
+    engine->status = E_BOOK_ERROR_OTHER_ERROR;
+    engine->error_message = dgettext(NULL, "addr_ni_importing_fail");
+
+    /* nothing got imported, so there is nothing to resume either */
+    while (engine->files)
+    {
+      if (engine->journal)
+      {
+        gchar *uri = g_file_get_uri(engine->files->data);
+
+        import_journal_remove(engine->journal, uri);
+        g_free(uri);
+      }
+
+      g_object_unref(engine->files->data);
+      engine->files = g_list_delete_link(engine->files, engine->files);
+    }
+
+    import_open_files(engine);
+  }
+}
+
+static gboolean
+is_vcard_or_directory(const char *content_type)
+{
+  return g_content_type_is_mime_type(content_type, "text/x-vcard") ||
+         !g_strcmp0("text/directory", content_type);
+}
+
+static gboolean
+has_vcard_extension(const char *name)
+{
+  const char *ext = name ? strrchr(name, '.') : NULL;
+
+  return ext && (!g_ascii_strcasecmp(ext, ".vcf") ||
+                 !g_ascii_strcasecmp(ext, ".vcard"));
+}
+
+/* Classifies a file without reading it. Only files which are neither named
+ * like a vCard nor have a telling content type need to be sniffed. */
+static import_file_type
+import_classify_file(const char *name, const char *content_type)
+{
+  if (has_vcard_extension(name) || is_vcard_or_directory(content_type))
+    return IMPORT_FILE_VCARD;
+
+  if (!content_type || g_content_type_is_unknown(content_type) ||
+      g_content_type_equals(content_type, "text/plain"))
+  {
+    return IMPORT_FILE_UNKNOWN;
+  }
+
+  return IMPORT_FILE_OTHER;
+}
+
+static void
+import_parse_func(gpointer data, gpointer user_data)
+{
+  import_parse_job *job = data;
+  import_source *source = job->source;
+  import_engine *engine = source->engine;
+  const gchar *card;
+  gsize len;
+
+  if (job->chunk)
+  {
+    vcard_tokenizer_feed(source->tokenizer,
+                         g_bytes_get_data(job->chunk, NULL),
+                         g_bytes_get_size(job->chunk));
+  }
+  else
+    vcard_tokenizer_close(source->tokenizer);
+
+  while (!g_cancellable_is_cancelled(engine->cancellable) &&
+         vcard_tokenizer_next(source->tokenizer, &card, &len))
+  {
+    gchar *vcard = g_strndup(card, len);
+    EContact *contact = e_contact_new_from_vcard(vcard);
+
+    if (contact && e_vcard_get_attributes(E_VCARD(contact)))
+    {
+      contact_index_match match = CONTACT_INDEX_NEW;
+      const gchar *uid = NULL;
+
+      if (engine->index)
+        match = contact_index_lookup(engine->index, contact, &uid);
+
+      if (match == CONTACT_INDEX_IDENTICAL)
+      {
+        g_object_unref(contact);
+        job->skipped++;
+      }
+      else
+      {
+        job->bytes += len;
+
+        if (match == CONTACT_INDEX_CHANGED)
+        {
+          e_contact_set(contact, E_CONTACT_UID, uid);
+          g_queue_push_tail(&job->updates, contact);
+        }
+        else
+          g_queue_push_tail(&job->contacts, contact);
+      }
+    }
+    else if (contact)
+      g_object_unref(contact);
+
+    g_free(vcard);
+  }
+
+  /* a single card that does not fit in the budget */
+  if (vcard_tokenizer_get_pending(source->tokenizer) > engine->memory_budget)
+  {
+    vcard_tokenizer_reset(source->tokenizer);
+    job->too_big = TRUE;
+  }
+
+  job->offset = source->base_offset +
+    vcard_tokenizer_get_offset(source->tokenizer);
+  g_idle_add(import_parse_done_cb, job);
+}
+
+static void
+import_source_drop_chunks(import_source *source)
+{
+  GBytes *chunk;
+
+  while ((chunk = g_queue_pop_head(&source->chunks)))
+  {
+    source->engine->chunks_bytes -= g_bytes_get_size(chunk);
+    g_bytes_unref(chunk);
+  }
+}
+
+static void
+import_source_done(import_source *source)
+{
+  import_engine *engine = source->engine;
+
+  engine->sources = g_list_remove(engine->sources, source);
+
+  /* whatever was not parsed won't ever be */
+  if (source->size >= 0)
+    engine->total_bytes -= source->size;
+
+  engine->total_bytes += source->parsed_bytes;
+
+  if (source->error)
+  {
+    if (!g_error_matches(source->error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      OSSO_ABOOK_WARN("Cannot import file: %s", source->error->message);
+      engine->error_message = dgettext(NULL, "addr_ni_importing_fail");
+    }
+  }
+  else if (source->bad_format)
+    engine->error_message = dgettext(NULL, "addr_ni_importing_fail_format");
+  else if (!source->contacts && !source->stop && !source->skipped)
+    engine->error_message = dgettext(NULL, "addr_ni_importing_fail");
+
+  import_source_free(source);
+  import_open_files(engine);
+}
+
+static void
+import_source_close_cb(GObject *source_object, GAsyncResult *res,
+                       gpointer user_data)
+{
+  g_input_stream_close_finish(G_INPUT_STREAM(source_object), res, NULL);
+  import_source_done(user_data);
+}
+
+static void
+import_source_read_cb(GObject *source_object, GAsyncResult *res,
+                      gpointer user_data)
+{
+  import_source *source = user_data;
+  GBytes *bytes;
+
+  bytes = g_input_stream_read_bytes_finish(G_INPUT_STREAM(source_object), res,
+                                           &source->error);
+  source->reading = FALSE;
+
+  if (!bytes)
+    source->stop = TRUE;
+  else if (!g_bytes_get_size(bytes))
+  {
+    source->eof = TRUE;
+    g_bytes_unref(bytes);
+  }
+  else
+  {
+    source->engine->chunks_bytes += g_bytes_get_size(bytes);
+    source->engine->read_bytes += g_bytes_get_size(bytes);
+    g_queue_push_tail(&source->chunks, bytes);
+  }
+
+  import_source_pump(source);
+}
+
+static void
+import_source_pump(import_source *source)
+{
+  import_engine *engine = source->engine;
+  gboolean over_budget = import_over_budget(engine);
+
+  /* still being opened */
+  if (!source->is)
+    return;
+
+  if (source->stop)
+    import_source_drop_chunks(source);
+  else if (!source->parsing && !source->parsed &&
+           (source->eof || !g_queue_is_empty(&source->chunks)) &&
+           (!over_budget ||
+            (g_queue_is_empty(&engine->contacts) && !engine->committing)))
+  {
+    import_parse_job *job = g_new0(import_parse_job, 1);
+
+    job->source = source;
+    job->chunk = g_queue_pop_head(&source->chunks);
+    source->parsing = TRUE;
+    g_thread_pool_push(engine->parser_pool, job, NULL);
+  }
+
+  if (!source->eof && !source->stop && !source->reading && !over_budget &&
+      g_queue_get_length(&source->chunks) < MAX_PENDING_CHUNKS)
+  {
+    source->reading = TRUE;
+    g_input_stream_read_bytes_async(source->is, READ_CHUNK_SIZE,
+                                    G_PRIORITY_DEFAULT, engine->cancellable,
+                                    import_source_read_cb, source);
+  }
+
+  if ((source->parsed || source->stop) && !source->reading &&
+      !source->parsing && !source->closing)
+  {
+    source->closing = TRUE;
+    g_input_stream_close_async(source->is, G_PRIORITY_DEFAULT, NULL,
+                               import_source_close_cb, source);
+  }
+}
+
+static gboolean
+import_parse_done_cb(gpointer user_data)
+{
+  import_parse_job *job = user_data;
+  import_source *source = job->source;
+  import_engine *engine = source->engine;
+  import_mark *mark = g_new(import_mark, 1);
+  EContact *contact;
+  int cards;
+
+  source->parsing = FALSE;
+
+  if (job->chunk)
+  {
+    gsize size = g_bytes_get_size(job->chunk);
+
+    engine->chunks_bytes -= size;
+    engine->parsed_bytes += size;
+    source->parsed_bytes += size;
+    g_bytes_unref(job->chunk);
+  }
+  else
+  {
+    source->parsed = TRUE;
+    source->journal->parsed = TRUE;
+  }
+
+  mark->offset = job->offset;
+  mark->pending = job->contacts.length + job->updates.length;
+  g_queue_push_tail(&source->journal->marks, mark);
+
+  cards = job->contacts.length + job->updates.length + job->skipped;
+  source->contacts += cards;
+  engine->imported_contacts += cards;
+  engine->skipped_contacts += job->skipped;
+  engine->processed_contacts += job->skipped;
+  engine->contacts_bytes += job->bytes;
+
+  /* Inline avatars are written to files by libosso-abook, which is not made
+   * for threads, so that is done here and not by the parsers */
+  while ((contact = g_queue_pop_head(&job->contacts)))
+  {
+    osso_abook_e_contact_persist_data(contact, NULL);
+    g_object_set_data(G_OBJECT(contact), "import-mark", mark);
+    g_queue_push_tail(&engine->contacts, contact);
+  }
+
+  while ((contact = g_queue_pop_head(&job->updates)))
+  {
+    osso_abook_e_contact_persist_data(contact, NULL);
+    g_object_set_data(G_OBJECT(contact), "import-mark", mark);
+    g_queue_push_tail(&engine->updates, contact);
+  }
+
+  if (job->too_big)
+    engine->error_message = dgettext(NULL, "addr_ni_importing_fail_size");
+
+  g_free(job);
+  import_commit_next(engine);
+
+  return FALSE;
+}
+
+/* Skips whatever an interrupted import of the same file already committed */
+static void
+import_source_start(import_source *source, GFileInputStream *is)
+{
+  import_engine *engine = source->engine;
+  import_file_journal *jf = g_new0(import_file_journal, 1);
+
+  jf->uri = g_file_get_uri(source->file);
+  jf->parent = source->parent;
+  jf->size = MAX(source->size, 0);
+  g_queue_init(&jf->marks);
+
+  if (engine->journal && source->size > 0 &&
+      g_seekable_can_seek(G_SEEKABLE(is)))
+  {
+    guint64 offset = import_journal_get_offset(
+          engine->journal, jf->uri, e_source_get_uid(engine->book_source),
+          source->size);
+    GError *error = NULL;
+
+    if (offset && g_seekable_seek(G_SEEKABLE(is), offset, G_SEEK_SET,
+                                  engine->cancellable, &error))
+    {
+      OSSO_ABOOK_NOTE(CONTACT_ADD,
+                      "resuming import of %s at %" G_GUINT64_FORMAT,
+                      jf->uri, offset);
+      source->base_offset = offset;
+      source->size -= offset;
+      engine->total_bytes -= offset;
+    }
+    else if (error)
+    {
+      OSSO_ABOOK_WARN("Cannot resume import of %s: %s", jf->uri,
+                      error->message);
+      g_error_free(error);
+    }
+  }
+
+  /* written out with the first batch */
+  jf->committed = source->base_offset;
+
+  if (engine->journal)
+  {
+    import_journal_update(engine->journal, jf->uri,
+                          e_source_get_uid(engine->book_source), jf->parent,
+                          jf->size, jf->committed);
+  }
+
+  engine->journal_files = g_list_prepend(engine->journal_files, jf);
+  source->journal = jf;
+  source->is = G_INPUT_STREAM(is);
+  import_source_pump(source);
+}
+
+static void
+import_file_size_cb(GObject *source_object, GAsyncResult *res,
+                    gpointer user_data)
+{
+  import_source *source = user_data;
+  GFileInfo *info;
+
+  info = g_file_input_stream_query_info_finish(
+      G_FILE_INPUT_STREAM(source_object), res, NULL);
+
+  if (info)
+  {
+    source->size = g_file_info_get_size(info);
+    source->engine->total_bytes += source->size;
+    g_object_unref(info);
+  }
+
+  import_source_start(source, G_FILE_INPUT_STREAM(source_object));
+}
+
+static void
+import_file_read_cb(GObject *source_object, GAsyncResult *res,
+                    gpointer user_data)
+{
+  import_source *source = user_data;
+  GFileInputStream *is;
+
+  is = g_file_read_finish(G_FILE(source_object), res, &source->error);
+
+  if (!is)
+    import_source_done(source);
+  else if (source->size < 0)
+  {
+    g_file_input_stream_query_info_async(is, G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                         G_PRIORITY_DEFAULT,
+                                         source->engine->cancellable,
+                                         import_file_size_cb, source);
+  }
+  else
+    import_source_start(source, is);
+}
+
+static void
+import_file_query_info_cb(GObject *source_object, GAsyncResult *res,
+                          gpointer user_data)
+{
+  import_source *source = user_data;
+  GFileInfo *info;
+
+  info = g_file_query_info_finish(G_FILE(source_object), res, &source->error);
+
+  if (info && !source->stop &&
+      is_vcard_or_directory(g_file_info_get_content_type(info)))
+  {
+    g_file_read_async(source->file, G_PRIORITY_DEFAULT,
+                      source->engine->cancellable, import_file_read_cb,
+                      source);
+  }
+  else
+  {
+    /* only files the user picked are worth complaining about, a directory
+     * may hold anything */
+    if (info && !source->stop)
+    {
+      if (source->parent)
+        source->skipped = TRUE;
+      else
+        source->bad_format = TRUE;
+    }
+
+    import_source_done(source);
+  }
+
+  if (info)
+    g_object_unref(info);
+}
+
+static import_file_type
+import_get_file_type(import_engine *engine, import_source *source)
+{
+  import_file_class *fc = g_hash_table_lookup(engine->file_types,
+                                              source->file);
+  import_file_type type;
+  gchar *name;
+
+  if (fc)
+  {
+    source->size = fc->size;
+    source->parent = fc->parent;
+
+    return fc->type;
+  }
+
+  source->size = -1;
+  name = g_file_get_basename(source->file);
+  type = import_classify_file(name, NULL);
+  g_free(name);
+
+  return type;
+}
+
+/* Keeps up to parallel_files files being read and parsed. Contacts from all of
+ * them end up in the same commit queue. Whatever is left gets committed once
+ * the last one is done. */
+static void
+import_open_files(import_engine *engine)
+{
+  while (engine->files &&
+         g_list_length(engine->sources) < engine->parallel_files &&
+         !g_cancellable_is_cancelled(engine->cancellable) &&
+         !engine->commit_failed)
+  {
+    import_source *source = g_new0(import_source, 1);
+
+    source->engine = engine;
+    source->file = engine->files->data;
+    source->tokenizer = vcard_tokenizer_new();
+    g_queue_init(&source->chunks);
+    engine->files = g_list_delete_link(engine->files, engine->files);
+    engine->sources = g_list_prepend(engine->sources, source);
+
+    if (OSSO_ABOOK_DEBUG_FLAGS(CONTACT_ADD))
+    {
+      gchar *uri = g_file_get_uri(source->file);
+
+      OSSO_ABOOK_NOTE(CONTACT_ADD, "importing file: %s", uri);
+      g_free(uri);
+    }
+
+    if (import_get_file_type(engine, source) == IMPORT_FILE_VCARD)
+    {
+      g_file_read_async(source->file, G_PRIORITY_DEFAULT, engine->cancellable,
+                        import_file_read_cb, source);
+    }
+    else
+    {
+      g_file_query_info_async(source->file,
+                              G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE,
+                              G_FILE_QUERY_INFO_NONE, G_PRIORITY_DEFAULT,
+                              engine->cancellable, import_file_query_info_cb,
+                              source);
+    }
+  }
+
+  if (!engine->sources && !engine->flush)
+  {
+    engine->flush = TRUE;
+    import_commit_next(engine);
+  }
+}
+
+/* the book is indexed first, to find out which contacts are there */
+static void
+import_connect(import_engine *engine)
+{
+  if (engine->files && !g_cancellable_is_cancelled(engine->cancellable))
+  {
+    e_book_client_connect(engine->book_source, 30, engine->cancellable,
+                          book_client_connect_cb, engine);
+  }
+  else
+    import_open_files(engine);
+}
+
+static void
+enumerator_next_files_cb(GObject *source_object, GAsyncResult *res,
+                         gpointer user_data)
+{
+  import_engine *engine = user_data;
+  GFileEnumerator *enumerator = G_FILE_ENUMERATOR(source_object);
+  GError *error = NULL;
+  GList *infos;
+
+  infos = g_file_enumerator_next_files_finish(enumerator, res, &error);
+
+  if (infos)
+  {
+    GFile *container = g_file_enumerator_get_container(enumerator);
+    const gchar *parent = engine->dir_uris->data;
+
+    while (infos)
+    {
+      GFileInfo *info = infos->data;
+      const char *name = g_file_info_get_name(info);
+      import_file_type type;
+
+      type = import_classify_file(
+          name, g_file_info_get_attribute_string(
+            info, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE));
+
+      if (type != IMPORT_FILE_OTHER)
+      {
+        GFile *file = g_file_get_child(container, name);
+        import_file_class *fc = g_new(import_file_class, 1);
+
+        fc->type = type;
+        fc->size = g_file_info_get_size(info);
+        fc->parent = parent;
+        engine->total_bytes += fc->size;
+        engine->files = g_list_prepend(engine->files, file);
+        g_hash_table_insert(engine->file_types, g_object_ref(file), fc);
+      }
+
+      infos = g_list_delete_link(infos, infos);
+      g_object_unref(info);
+    }
+
+    g_file_enumerator_next_files_async(enumerator, FILES_PER_BATCH, 0,
+                                       engine->cancellable,
+                                       enumerator_next_files_cb, engine);
+  }
+  else
+  {
+    if (error)
+    {
+      if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+      {
+        OSSO_ABOOK_WARN("Cannot list directory: %s", error->message);
+        engine->error_message = dgettext(NULL, "addr_ni_importing_fail");
+      }
+
+      g_error_free(error);
+    }
+
+    import_list_next_dir(engine);
+  }
+}
+
+static void
+enumerate_children_cb(GObject *source_object, GAsyncResult *res,
+                      gpointer user_data)
+{
+  import_engine *engine = user_data;
+  GFileEnumerator *enumerator;
+  GError *error = NULL;
+
+  enumerator = g_file_enumerate_children_finish(G_FILE(source_object),
+                                                res, &error);
+
+  if (enumerator)
+  {
+    g_file_enumerator_next_files_async(enumerator, FILES_PER_BATCH, 0,
+                                       engine->cancellable,
+                                       enumerator_next_files_cb, engine);
+    g_object_unref(enumerator);
+  }
+  else
+  {
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      OSSO_ABOOK_WARN("Cannot list directory: %s", error->message);
+      engine->error_message = dgettext(NULL, "addr_ni_importing_fail");
+    }
+
+    g_error_free(error);
+    import_list_next_dir(engine);
+  }
+}
+
+/* Directories are listed one after the other, before any file is opened */
+static void
+import_list_next_dir(import_engine *engine)
+{
+  GFile *dir;
+
+  if (!engine->dirs || g_cancellable_is_cancelled(engine->cancellable))
+  {
+    import_connect(engine);
+    return;
+  }
+
+  dir = engine->dirs->data;
+  engine->dirs = g_list_delete_link(engine->dirs, engine->dirs);
+  engine->dir_uris = g_slist_prepend(engine->dir_uris, g_file_get_uri(dir));
+
+  if (engine->journal)
+  {
+    import_journal_add_directory(engine->journal, engine->dir_uris->data,
+                                 e_source_get_uid(engine->book_source));
+  }
+
+  g_file_enumerate_children_async(dir,
+                                  G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                  G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE
+                                  "," G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                  G_FILE_QUERY_INFO_NONE, 0,
+                                  engine->cancellable, enumerate_children_cb,
+                                  engine);
+  g_object_unref(dir);
+}
+
+void
+import_engine_add_file(import_engine *engine, const gchar *uri)
+{
+  g_return_if_fail(engine != NULL);
+  g_return_if_fail(uri != NULL);
+
+  engine->files = g_list_append(engine->files, g_file_new_for_uri(uri));
+}
+
+void
+import_engine_add_directory(import_engine *engine, const gchar *uri)
+{
+  g_return_if_fail(engine != NULL);
+  g_return_if_fail(uri != NULL);
+
+  engine->dirs = g_list_append(engine->dirs, g_file_new_for_uri(uri));
+}
+
+void
+import_engine_start(import_engine *engine)
+{
+  g_return_if_fail(engine != NULL);
+
+  engine->start_time = g_get_monotonic_time();
+  import_list_next_dir(engine);
+}
+
+gboolean
+import_engine_is_pending_directory(const gchar *uri)
+{
+  import_journal *journal = import_journal_open();
+  gboolean rv = import_journal_is_directory(journal, uri);
+
+  import_journal_free(journal);
+
+  return rv;
+}
@@ -0,0 +1,82 @@
+/*
+ * import-engine.h
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef IMPORT_ENGINE_H
+#define IMPORT_ENGINE_H
+
+#include <libedataserver/libedataserver.h>
+
+typedef struct _import_engine import_engine;
+
+typedef struct
+{
+  /* in microseconds */
+  gint64 elapsed;
+  gint64 total_bytes;
+  guint64 read_bytes;
+  guint64 parsed_bytes;
+  int parsed_contacts;
+  int committed_contacts;
+  int updated_contacts;
+  int skipped_contacts;
+} import_stats;
+
+typedef void (*import_engine_done_cb)(import_engine *engine,
+                                      gpointer user_data);
+
+/* Imports vCard files into the address book of source. Without a journal an
+ * interrupted import cannot be resumed. */
+import_engine *
+import_engine_new(ESource *source, gboolean journal,
+                  import_engine_done_cb cb, gpointer user_data);
+
+void
+import_engine_free(import_engine *engine);
+
+void
+import_engine_add_file(import_engine *engine, const gchar *uri);
+
+/* vCards in the directory, subdirectories are not looked into */
+void
+import_engine_add_directory(import_engine *engine, const gchar *uri);
+
+/* cb gets called once everything is imported, the import failed or got
+ * cancelled */
+void
+import_engine_start(import_engine *engine);
+
+void
+import_engine_cancel(import_engine *engine);
+
+/* 0.0 until the first contacts are committed */
+gdouble
+import_engine_get_progress(import_engine *engine);
+
+void
+import_engine_get_stats(import_engine *engine, import_stats *stats);
+
+/* Translated message for the user, NULL if the import succeeded */
+const gchar *
+import_engine_get_error_message(import_engine *engine);
+
+/* TRUE if uri is a directory an interrupted import was reading from */
+gboolean
+import_engine_is_pending_directory(const gchar *uri);
+
+#endif // IMPORT_ENGINE_H
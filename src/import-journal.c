@@ -0,0 +1,275 @@
+/*
+ * import-journal.c
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <glib/gstdio.h>
+
+#include <errno.h>
+
+#include <libosso-abook/osso-abook-log.h>
+
+#include "import-journal.h"
+
+#define JOURNAL_GROUP "journal"
+
+struct _import_journal
+{
+  gchar *path;
+  GKeyFile *key_file;
+  gboolean dirty;
+};
+
+static gchar *
+import_journal_get_path()
+{
+  return g_build_filename(g_get_home_dir(), ".osso-abook", "import-journal",
+                          NULL);
+}
+
+import_journal *
+import_journal_open(void)
+{
+  import_journal *journal = g_new0(import_journal, 1);
+  GError *error = NULL;
+
+  journal->path = import_journal_get_path();
+  journal->key_file = g_key_file_new();
+
+  if (!g_key_file_load_from_file(journal->key_file, journal->path,
+                                 G_KEY_FILE_NONE, &error))
+  {
+    if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+    {
+      OSSO_ABOOK_WARN("Cannot load import journal %s: %s", journal->path,
+                      error->message);
+    }
+
+    g_error_free(error);
+  }
+
+  return journal;
+}
+
+void
+import_journal_free(import_journal *journal)
+{
+  if (!journal)
+    return;
+
+  g_key_file_free(journal->key_file);
+  g_free(journal->path);
+  g_free(journal);
+}
+
+static gboolean
+import_journal_is_for_book(GKeyFile *key_file, const gchar *uri,
+                           const gchar *book)
+{
+  gchar *uid = g_key_file_get_string(key_file, uri, "book", NULL);
+  gboolean rv = !g_strcmp0(uid, book);
+
+  g_free(uid);
+
+  return rv;
+}
+
+guint64
+import_journal_get_offset(import_journal *journal, const gchar *uri,
+                          const gchar *book, guint64 size)
+{
+  GKeyFile *key_file;
+  guint64 offset;
+
+  g_return_val_if_fail(journal != NULL, 0);
+  g_return_val_if_fail(uri != NULL, 0);
+
+  key_file = journal->key_file;
+
+  /* what went to another book is not in this one */
+  if (!g_key_file_has_group(key_file, uri) ||
+      !import_journal_is_for_book(key_file, uri, book) ||
+      g_key_file_get_uint64(key_file, uri, "size", NULL) != size)
+  {
+    return 0;
+  }
+
+  offset = g_key_file_get_uint64(key_file, uri, "offset", NULL);
+
+  return offset < size ? offset : 0;
+}
+
+void
+import_journal_add_directory(import_journal *journal, const gchar *uri,
+                             const gchar *book)
+{
+  g_return_if_fail(journal != NULL);
+  g_return_if_fail(uri != NULL);
+
+  g_key_file_set_boolean(journal->key_file, uri, "directory", TRUE);
+  g_key_file_set_string(journal->key_file, uri, "book", book);
+  journal->dirty = TRUE;
+}
+
+gboolean
+import_journal_is_directory(import_journal *journal, const gchar *uri)
+{
+  g_return_val_if_fail(journal != NULL, FALSE);
+  g_return_val_if_fail(uri != NULL, FALSE);
+
+  return g_key_file_get_boolean(journal->key_file, uri, "directory", NULL);
+}
+
+void
+import_journal_update(import_journal *journal, const gchar *uri,
+                      const gchar *book, const gchar *parent, guint64 size,
+                      guint64 offset)
+{
+  GKeyFile *key_file;
+  guint64 sequence;
+
+  g_return_if_fail(journal != NULL);
+  g_return_if_fail(uri != NULL);
+
+  key_file = journal->key_file;
+  sequence = g_key_file_get_uint64(key_file, JOURNAL_GROUP, "sequence",
+                                   NULL) + 1;
+
+  g_key_file_set_uint64(key_file, JOURNAL_GROUP, "sequence", sequence);
+  g_key_file_set_uint64(key_file, uri, "size", size);
+  g_key_file_set_uint64(key_file, uri, "offset", offset);
+  g_key_file_set_uint64(key_file, uri, "sequence", sequence);
+  g_key_file_set_string(key_file, uri, "book", book);
+
+  if (parent)
+    g_key_file_set_string(key_file, uri, "parent", parent);
+
+  journal->dirty = TRUE;
+}
+
+void
+import_journal_remove(import_journal *journal, const gchar *uri)
+{
+  gchar **groups;
+  gchar **group;
+
+  g_return_if_fail(journal != NULL);
+  g_return_if_fail(uri != NULL);
+
+  groups = g_key_file_get_groups(journal->key_file, NULL);
+
+  /* files of a directory go with it */
+  for (group = groups; *group; group++)
+  {
+    gchar *parent = g_key_file_get_string(journal->key_file, *group, "parent",
+                                          NULL);
+
+    if (!g_strcmp0(*group, uri) || !g_strcmp0(parent, uri))
+    {
+      g_key_file_remove_group(journal->key_file, *group, NULL);
+      journal->dirty = TRUE;
+    }
+
+    g_free(parent);
+  }
+
+  g_strfreev(groups);
+}
+
+gboolean
+import_journal_sync(import_journal *journal)
+{
+  GError *error = NULL;
+  gchar **groups;
+  gboolean rv = TRUE;
+
+  g_return_val_if_fail(journal != NULL, FALSE);
+
+  if (!journal->dirty)
+    return TRUE;
+
+  groups = g_key_file_get_groups(journal->key_file, NULL);
+
+  /* nothing pending, don't leave an empty journal behind */
+  if (!groups[0] || (!groups[1] && !g_strcmp0(groups[0], JOURNAL_GROUP)))
+  {
+    if (g_unlink(journal->path) && errno != ENOENT)
+    {
+      OSSO_ABOOK_WARN("Cannot remove import journal %s: %s", journal->path,
+                      g_strerror(errno));
+      rv = FALSE;
+    }
+  }
+  else
+  {
+    gchar *dir = g_path_get_dirname(journal->path);
+    gsize len;
+    gchar *data = g_key_file_to_data(journal->key_file, &len, NULL);
+
+    g_mkdir_with_parents(dir, 0755);
+
+    if (!g_file_set_contents(journal->path, data, len, &error))
+    {
+      OSSO_ABOOK_WARN("Cannot write import journal %s: %s", journal->path,
+                      error->message);
+      g_error_free(error);
+      rv = FALSE;
+    }
+
+    g_free(data);
+    g_free(dir);
+  }
+
+  g_strfreev(groups);
+  journal->dirty = !rv;
+
+  return rv;
+}
+
+gchar **
+import_journal_list_pending(const gchar *book)
+{
+  import_journal *journal = import_journal_open();
+  gchar **groups = g_key_file_get_groups(journal->key_file, NULL);
+  GPtrArray *uris = g_ptr_array_new();
+  gchar **group;
+
+  for (group = groups; *group; group++)
+  {
+    gchar *parent;
+
+    if (!g_strcmp0(*group, JOURNAL_GROUP) ||
+        !import_journal_is_for_book(journal->key_file, *group, book))
+    {
+      continue;
+    }
+
+    /* files of a directory import get resumed with the directory */
+    parent = g_key_file_get_string(journal->key_file, *group, "parent", NULL);
+
+    if (!parent || !g_key_file_has_group(journal->key_file, parent))
+      g_ptr_array_add(uris, g_strdup(*group));
+
+    g_free(parent);
+  }
+
+  g_ptr_array_add(uris, NULL);
+  g_strfreev(groups);
+  import_journal_free(journal);
+
+  return (gchar **)g_ptr_array_free(uris, FALSE);
+}
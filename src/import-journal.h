@@ -0,0 +1,67 @@
+/*
+ * import-journal.h
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef IMPORT_JOURNAL_H
+#define IMPORT_JOURNAL_H
+
+#include <glib.h>
+
+typedef struct _import_journal import_journal;
+
+import_journal *
+import_journal_open(void);
+
+void
+import_journal_free(import_journal *journal);
+
+/* Returns the offset up to which the file was committed by an interrupted
+ * import to the book with source UID book, 0 if there is none or the file has
+ * changed since */
+guint64
+import_journal_get_offset(import_journal *journal, const gchar *uri,
+                          const gchar *book, guint64 size);
+
+void
+import_journal_add_directory(import_journal *journal, const gchar *uri,
+                             const gchar *book);
+
+gboolean
+import_journal_is_directory(import_journal *journal, const gchar *uri);
+
+/* parent is the directory being imported, if any */
+void
+import_journal_update(import_journal *journal, const gchar *uri,
+                      const gchar *book, const gchar *parent, guint64 size,
+                      guint64 offset);
+
+/* Removing a directory removes the files imported from it too */
+void
+import_journal_remove(import_journal *journal, const gchar *uri);
+
+/* Writes the journal to disk if it has changed. The old journal is replaced
+ * atomically, so a crash leaves either of them in place. */
+gboolean
+import_journal_sync(import_journal *journal);
+
+/* URIs of the imports to the book with source UID book that were interrupted,
+ * NULL terminated */
+gchar **
+import_journal_list_pending(const gchar *book);
+
+#endif // IMPORT_JOURNAL_H
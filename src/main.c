@@ -4,6 +4,8 @@
 #include <libosso-abook/osso-abook-init.h>
 
 #include "app.h"
+#include "restore-engine.h"
+#include "trace.h"
 
 #ifdef OSSO_ABOOK_DEBUG
 void
@@ -41,10 +43,73 @@ backend_died_cb(EBook *book, gpointer user_data)
   exit(status);
 }
 
+static void
+restore_done_cb(restore_engine *engine, gpointer user_data)
+{
+  g_main_loop_quit(user_data);
+}
+
+static gboolean
+restore_progress_cb(gpointer user_data)
+{
+  restore_stats stats;
+
+  restore_engine_get_stats(user_data, &stats);
+  g_print("%d/%d contacts restored\n", stats.restored_contacts,
+          stats.total_contacts);
+
+  return TRUE;
+}
+
+/* Without a window, for the restore script */
+static int
+restore(const gchar *path, const gchar *generation)
+{
+  GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+  restore_engine *engine;
+  restore_stats stats;
+  guint progress_id;
+  int res = 0;
+
+  engine = restore_engine_new(path, generation, restore_done_cb, loop);
+  progress_id = g_timeout_add_seconds(1, restore_progress_cb, engine);
+  restore_engine_start(engine);
+  g_main_loop_run(loop);
+  g_source_remove(progress_id);
+
+  restore_engine_get_stats(engine, &stats);
+
+  if (restore_engine_get_error(engine))
+  {
+    g_printerr("Restore failed: %s\n",
+               restore_engine_get_error(engine)->message);
+    res = 1;
+  }
+  else
+  {
+    g_print("%d contacts restored to %d books in %.2f s\n",
+            stats.restored_contacts, stats.books,
+            stats.elapsed / (gdouble)G_USEC_PER_SEC);
+  }
+
+  if (stats.skipped_books)
+  {
+    g_print("%d roster books with %d contacts left to their accounts\n",
+            stats.skipped_books, stats.skipped_contacts);
+  }
+
+  restore_engine_free(engine);
+  g_main_loop_unref(loop);
+
+  return res;
+}
+
 int
 main(int argc, char **argv)
 {
   osso_abook_data data;
+  gchar *restore_path = NULL;
+  gchar *restore_generation = NULL;
   GOptionEntry entries[] =
   {
     {
@@ -57,6 +122,21 @@ main(int argc, char **argv)
       .description = "Quit when the application window is closed",
       .arg_data = &data.quit_on_close
     },
+    {
+      .long_name = "restore",
+      .description = "Restore the address books from a backup or an export, "
+                     "and quit",
+      .arg = G_OPTION_ARG_FILENAME,
+      .arg_data = &restore_path,
+      .arg_description = "PATH"
+    },
+    {
+      .long_name = "generation",
+      .description = "Backup generation to restore, the newest by default",
+      .arg = G_OPTION_ARG_STRING,
+      .arg_data = &restore_generation,
+      .arg_description = "NAME"
+    },
     {
     }
   };
@@ -66,6 +146,9 @@ main(int argc, char **argv)
   GtkIconFactory *icon_factory;
   int res = 1;
   GError *error = NULL;
+  gint64 span;
+
+  trace_init();
 
 #if !GLIB_CHECK_VERSION(2,32,0)
   g_thread_init(NULL);
@@ -74,7 +157,9 @@ main(int argc, char **argv)
   bindtextdomain("osso-addressbook", "/usr/share/locale");
   bind_textdomain_codeset("osso-addressbook", "UTF-8");
   textdomain("osso-addressbook");
+  span = trace_begin();
   osso = osso_initialize("osso_addressbook", "4.20100629", 1, 0);
+  trace_end("osso init", span);
 
   if (!osso)
   {
@@ -86,6 +171,8 @@ main(int argc, char **argv)
   memset(&data, 0, sizeof(data));
   gtk_rc_parse_string("style \"default\" {\n}\nclass \"HildonAppMenu\" style \"default\"\n");
 
+  span = trace_begin();
+
   if (!osso_abook_init_with_args(&argc, &argv, osso, 0, entries, 0, &error))
   {
     if (error && g_option_error_quark() == error->domain)
@@ -103,10 +190,19 @@ main(int argc, char **argv)
     goto err_osso;
   }
 
+  trace_end("libosso-abook init", span);
+
+  if (restore_path)
+  {
+    res = restore(restore_path, restore_generation);
+    goto err_osso;
+  }
+
   osso_abook_set_backend_died_func(backend_died_cb, &data);
 
   OSSO_ABOOK_NOTE(STARTUP, STARTUP_PROGRESS_SEPARATOR);
 
+  span = trace_begin();
   icon_source = gtk_icon_source_new();
   gtk_icon_source_set_icon_name(icon_source, "qgn_addr_icon_search_in_group");
   icon_set = gtk_icon_set_new();
@@ -118,16 +214,22 @@ main(int argc, char **argv)
   gtk_icon_factory_add_default(icon_factory);
   g_object_unref(icon_factory);
   gtk_window_set_default_icon_name("qgn_list_addressbook");
+  trace_end("icons", span);
 
   OSSO_ABOOK_NOTE(STARTUP, STARTUP_PROGRESS_SEPARATOR);
 
+  span = trace_begin();
+
   if (app_create(osso, argc < 2 ? NULL : argv[1] , &data))
   {
+    trace_end("app_create", span);
+    trace_mark("main loop");
     OSSO_ABOOK_NOTE(STARTUP, STARTUP_PROGRESS_SEPARATOR);
 
     g_object_set(gtk_settings_get_default(), "gtk-button-images", TRUE, NULL);
     gtk_main();
     app_destroy(&data);
+    trace_write();
 
 #ifdef OSSO_ABOOK_DEBUG
     list_leaked_windows();
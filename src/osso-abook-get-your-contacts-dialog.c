@@ -486,7 +486,7 @@ create_buttons(OssoABookGetYourContactsDialog *dialog, GtkBox *box)
   {
     gtk_widget_hide(priv->get_sim_contacts_button);
     priv->sim_group_available_id = g_signal_connect(
-          priv->app_data->sim_group, "available",
+          app_ensure_sim_group(priv->app_data), "available",
           G_CALLBACK(sim_group_available_cb), dialog);
   }
   else
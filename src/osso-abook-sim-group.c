@@ -28,6 +28,7 @@
 #include <stdlib.h>
 
 #include "osso-abook-sim-group.h"
+#include "sim-cache.h"
 
 struct sim_group_capabilities
 {
@@ -51,6 +52,18 @@ struct _OssoABookSimGroupPrivate
   GQueue *closures;
   int aggregator_num;
   struct sim_group_capabilities *capabilities;
+  ESourceRegistry *registry;
+  GCancellable *cancellable;
+
+  /* served from the cache until the card is read, vCard -> contact */
+  GHashTable *cached_adn;
+  GHashTable *cached_sdn;
+  gboolean vmbx_cached;
+
+  /* what is read from the card, saved once every book is */
+  sim_cache *card;
+
+  gint64 start_time;
 };
 
 typedef struct _OssoABookSimGroupPrivate OssoABookSimGroupPrivate;
@@ -138,6 +151,15 @@ osso_abook_sim_group_dispose(GObject *object)
   OssoABookSimGroup *sim_group = OSSO_ABOOK_SIM_GROUP(object);
   OssoABookSimGroupPrivate *priv = OSSO_ABOOK_SIM_GROUP_PRIVATE(sim_group);
 
+  /* books still being opened are dropped when they are */
+  g_cancellable_cancel(priv->cancellable);
+
+  if (priv->registry)
+  {
+    g_object_unref(priv->registry);
+    priv->registry = NULL;
+  }
+
   if (priv->vmbx_contact)
   {
     g_object_unref(priv->vmbx_contact);
@@ -156,6 +178,18 @@ osso_abook_sim_group_dispose(GObject *object)
   if (priv->contacts_by_full_name)
     g_hash_table_remove_all(priv->contacts_by_full_name);
 
+  if (priv->cached_adn)
+  {
+    g_hash_table_destroy(priv->cached_adn);
+    priv->cached_adn = NULL;
+  }
+
+  if (priv->cached_sdn)
+  {
+    g_hash_table_destroy(priv->cached_sdn);
+    priv->cached_sdn = NULL;
+  }
+
   if (priv->contact_model)
   {
     g_object_unref(priv->contact_model);
@@ -168,6 +202,16 @@ osso_abook_sim_group_dispose(GObject *object)
   G_OBJECT_CLASS(osso_abook_sim_group_parent_class)->dispose(object);
 }
 
+static void
+osso_abook_sim_capabilities_free(struct sim_group_capabilities *capabilities)
+{
+  if (capabilities)
+  {
+    g_free(capabilities->imsi);
+    g_slice_free(struct sim_group_capabilities, capabilities);
+  }
+}
+
 static void
 osso_abook_sim_group_finalize(GObject *object)
 {
@@ -181,12 +225,9 @@ osso_abook_sim_group_finalize(GObject *object)
     g_hash_table_destroy(priv->contacts_by_full_name);
 
   g_queue_free(priv->closures);
-
-  if (priv->capabilities)
-  {
-    g_free(priv->capabilities->imsi);
-    g_slice_free(struct sim_group_capabilities, priv->capabilities);
-  }
+  g_object_unref(priv->cancellable);
+  sim_cache_free(priv->card);
+  osso_abook_sim_capabilities_free(priv->capabilities);
 
   G_OBJECT_CLASS(osso_abook_sim_group_parent_class)->finalize(object);
 }
@@ -261,6 +302,60 @@ osso_abook_sim_group_class_init(OssoABookSimGroupClass *klass)
         0, NULL, g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
 }
 
+/* OSSO_ABOOK_FAKE_SIM makes the SIM books local, file backed ones, so the
+ * group can be tested and benchmarked without a modem. Its value is the static
+ * capabilities the fake card reports, like "imsi=001010000000001,
+ * max_num_of_entries=250". */
+static const char *
+fake_sim_capabilities(void)
+{
+  return g_getenv("OSSO_ABOOK_FAKE_SIM");
+}
+
+static const char *
+roster_backend_name(void)
+{
+  return fake_sim_capabilities() ? "local" : "sim";
+}
+
+static gchar *
+roster_source_uid(const gchar *uid)
+{
+  gchar *_uid = g_strconcat(fake_sim_capabilities() ?
+                            OSSO_ABOOK_FAKE_SIM_UID_PREFIX : "", uid, NULL);
+
+  e_filename_make_safe(_uid);
+
+  return _uid;
+}
+
+/* the SIM book a roster reads, whatever the UID of its source */
+static const char *
+roster_book_name(OssoABookRoster *roster)
+{
+  const char *uri = osso_abook_roster_get_book_uri(roster);
+
+  if (uri && fake_sim_capabilities() &&
+      g_str_has_prefix(uri, OSSO_ABOOK_FAKE_SIM_UID_PREFIX))
+  {
+    uri += strlen(OSSO_ABOOK_FAKE_SIM_UID_PREFIX);
+  }
+
+  return uri;
+}
+
+/* milliseconds every fake SIM book takes to open */
+static guint
+fake_sim_latency(void)
+{
+  const char *latency = g_getenv("OSSO_ABOOK_FAKE_SIM_LATENCY");
+
+  if (!fake_sim_capabilities() || !latency)
+    return 0;
+
+  return strtoul(latency, NULL, 10);
+}
+
 static gchar *
 _get_static_capability_string(const char *caps, const char *cap_name)
 {
@@ -368,7 +463,10 @@ osso_abook_sim_capabilities_new(EBook *book)
 
   g_return_val_if_fail(E_IS_BOOK(book), NULL);
 
-  caps = e_book_get_static_capabilities(book, NULL);
+  caps = fake_sim_capabilities();
+
+  if (!caps)
+    caps = e_book_get_static_capabilities(book, NULL);
 
   g_return_val_if_fail(caps, NULL);
 
@@ -384,12 +482,126 @@ osso_abook_sim_capabilities_new(EBook *book)
   return capabilities;
 }
 
+static void
+remove_contact_from_store(OssoABookContactModel *contact_model,
+                          OssoABookContact *contact)
+{
+  const char *uid = e_contact_get_const(E_CONTACT(contact), E_CONTACT_UID);
+  GtkTreeIter iter;
+
+  if (uid && osso_abook_contact_model_find_contact(contact_model, uid, &iter))
+    osso_abook_list_store_remove(OSSO_ABOOK_LIST_STORE(contact_model), &iter);
+}
+
+static void
+drop_cached_contacts(OssoABookContactModel *contact_model, GHashTable **cached)
+{
+  GHashTableIter iter;
+  gpointer contact;
+
+  if (!*cached)
+    return;
+
+  g_hash_table_iter_init(&iter, *cached);
+
+  while (g_hash_table_iter_next(&iter, NULL, &contact))
+    remove_contact_from_store(contact_model, contact);
+
+  g_hash_table_destroy(*cached);
+  *cached = NULL;
+}
+
+/* Contacts that were served from the cache already stay in the store, so the
+ * model only changes if the card differs from what was cached */
+static void
+update_contacts(OssoABookSimGroup *sim_group, const char *book,
+                GSList **contacts, GHashTable **cached)
+{
+  OssoABookSimGroupPrivate *priv = OSSO_ABOOK_SIM_GROUP_PRIVATE(sim_group);
+  GPtrArray *vcards = g_ptr_array_new_with_free_func(g_free);
+  GSList *added = NULL;
+  GSList *c;
+  guint removed = 0;
+
+  for (c = *contacts; c; c = g_slist_delete_link(c, c))
+  {
+    gchar *vcard = e_vcard_to_string(E_VCARD(c->data), EVC_FORMAT_VCARD_30);
+
+    if (*cached && g_hash_table_remove(*cached, vcard))
+      g_object_unref(c->data);
+    else
+      added = g_slist_prepend(added, c->data);
+
+    g_ptr_array_add(vcards, vcard);
+  }
+
+  *contacts = NULL;
+
+  if (*cached)
+  {
+    removed = g_hash_table_size(*cached);
+    drop_cached_contacts(priv->contact_model, cached);
+  }
+
+  OSSO_ABOOK_NOTE(EDS, "%s book read, %d contacts added, %d removed", book,
+                  g_slist_length(added), removed);
+
+  if (added)
+    add_contacts_to_store(OSSO_ABOOK_LIST_STORE(priv->contact_model), &added);
+
+  if (priv->card)
+  {
+    g_ptr_array_add(vcards, NULL);
+    sim_cache_set_list(priv->card, book, (const gchar * const *)vcards->pdata);
+  }
+
+  g_ptr_array_free(vcards, TRUE);
+}
+
+static void
+cache_capabilities(sim_cache *cache,
+                   struct sim_group_capabilities *capabilities)
+{
+  sim_cache_set_imsi(cache, capabilities->imsi);
+  sim_cache_set_capability(cache, "max_num_of_entries",
+                           capabilities->max_num_of_entries);
+  sim_cache_set_capability(cache, "max_num_of_sne_entries",
+                           capabilities->max_num_of_sne_entries);
+  sim_cache_set_capability(cache, "max_num_of_email_entries",
+                           capabilities->max_num_of_email_entries);
+}
+
+static void
+cache_voicemail_numbers(OssoABookSimGroup *sim_group)
+{
+  OssoABookSimGroupPrivate *priv = OSSO_ABOOK_SIM_GROUP_PRIVATE(sim_group);
+  GPtrArray *numbers;
+  GList *tel = NULL;
+  GList *l;
+
+  if (!priv->card)
+    return;
+
+  numbers = g_ptr_array_new_with_free_func(g_free);
+
+  if (priv->vmbx_contact)
+    tel = e_contact_get(E_CONTACT(priv->vmbx_contact), E_CONTACT_TEL);
+
+  for (l = tel; l; l = l->next)
+    g_ptr_array_add(numbers, l->data);
+
+  g_list_free(tel);
+  g_ptr_array_add(numbers, NULL);
+  sim_cache_set_list(priv->card, "mbdn", (const gchar * const *)numbers->pdata);
+  g_ptr_array_free(numbers, TRUE);
+}
+
 static void
 sequence_complete_cb(OssoABookRoster *roster, guint status, gpointer user_data)
 {
   OssoABookSimGroup *sim_group = OSSO_ABOOK_SIM_GROUP(user_data);
   OssoABookSimGroupPrivate *priv = OSSO_ABOOK_SIM_GROUP_PRIVATE(sim_group);
-  const char *uid = osso_abook_roster_get_book_uri(roster);
+  const char *uid = roster_book_name(roster);
 
   g_return_if_fail(uid != NULL);
 
@@ -404,26 +616,36 @@ sequence_complete_cb(OssoABookRoster *roster, guint status, gpointer user_data)
     priv->vmbx_ready = FALSE;
     priv->mbdn_ready = FALSE;
 
+    /* the cached voicemail box is gone from the card */
+    if (priv->vmbx_cached)
+    {
+      remove_contact_from_store(priv->contact_model, priv->vmbx_contact);
+      g_object_unref(priv->vmbx_contact);
+      priv->vmbx_contact = NULL;
+      priv->vmbx_cached = FALSE;
+    }
+
+    cache_voicemail_numbers(sim_group);
     g_signal_emit(G_OBJECT(sim_group), signals[VOICEMAIL_CONTACT_AVAILABLE], 0);
   }
 
   if (!strcmp(uid, "adn"))
   {
-    add_contacts_to_store(OSSO_ABOOK_LIST_STORE(priv->contact_model),
-                          &priv->adn_contacts);
+    update_contacts(sim_group, uid, &priv->adn_contacts, &priv->cached_adn);
     g_hash_table_destroy(priv->contacts_by_full_name);
     priv->contacts_by_full_name = NULL;
 
+    osso_abook_sim_capabilities_free(priv->capabilities);
     priv->capabilities = osso_abook_sim_capabilities_new(
           osso_abook_roster_get_book(roster));
 
+    if (priv->card && priv->capabilities)
+      cache_capabilities(priv->card, priv->capabilities);
+
     g_signal_emit(G_OBJECT(sim_group), signals[CAPABILITIES_AVAILABLE], 0);
   }
   else if (!strcmp(uid, "sdn"))
-  {
-    add_contacts_to_store(OSSO_ABOOK_LIST_STORE(priv->contact_model),
-                          &priv->sdn_contacts);
-  }
+    update_contacts(sim_group, uid, &priv->sdn_contacts, &priv->cached_sdn);
 }
 
 
@@ -436,76 +658,98 @@ sequence_complete_cb(OssoABookRoster *roster, guint status, gpointer user_data)
 static ESource *
 create_roster_source(const gchar *uid)
 {
-  gchar *_uid = g_strdup(uid);
+  gchar *_uid = roster_source_uid(uid);
   GError *error = NULL;
-  ESourceRegistry *registry;
-  ESource *source = NULL;
+  ESource *source;
 
-  registry = e_source_registry_new_sync(NULL, &error);
+  OSSO_ABOOK_NOTE(TP, "creating new EDS source %s for %s", _uid, uid);
+  source = e_source_new_with_uid(_uid, NULL, &error);
 
-  if (error)
+  if (source)
+  {
+    ESourceBackend *backend =
+        e_source_get_extension (source, E_SOURCE_EXTENSION_ADDRESS_BOOK);
+    ESourceResource *resource =
+        e_source_get_extension (source, E_SOURCE_EXTENSION_RESOURCE);
+
+    e_source_resource_set_identity(resource, uid);
+    e_source_backend_set_backend_name (backend, roster_backend_name());
+    e_source_set_display_name(source, uid);
+  }
+  else
   {
-    OSSO_ABOOK_WARN("Creating ESourceRegistry for uid %s failed - %s", uid,
+    OSSO_ABOOK_WARN("Creating ESource for uid %s failed - %s", uid,
                     error->message);
     g_clear_error(&error);
-    goto err_out;
   }
 
-  e_filename_make_safe(_uid);
+  g_free(_uid);
+
+  return source;
+}
+
+static ESource *
+lookup_roster_source(ESourceRegistry *registry, const gchar *uid,
+                     gboolean *foreign)
+{
+  gchar *_uid = roster_source_uid(uid);
+  ESource *source;
+
   source = e_source_registry_ref_source(registry, _uid);
+  *foreign = FALSE;
 
   if (source)
   {
+    ESourceBackend *backend;
+
     g_warn_if_fail(e_source_has_extension(source,
                                           E_SOURCE_EXTENSION_ADDRESS_BOOK));
     g_warn_if_fail(e_source_has_extension(source, E_SOURCE_EXTENSION_RESOURCE));
-  }
-  else
-  {
-    OSSO_ABOOK_NOTE(TP, "creating new EDS source %s for %s", _uid, uid);
-    source = e_source_new_with_uid(_uid, NULL, &error);
-
-    if (source)
-    {
-      ESourceBackend *backend =
-          e_source_get_extension (source, E_SOURCE_EXTENSION_ADDRESS_BOOK);
-      ESourceResource *resource =
-          e_source_get_extension (source, E_SOURCE_EXTENSION_RESOURCE);
-      GList *sources = NULL;
-
-      e_source_resource_set_identity(resource, uid);
-      e_source_backend_set_backend_name (backend, "sim");
-      e_source_set_display_name(source, uid);
 
-      sources = g_list_append(sources, source);
-      e_source_registry_create_sources_sync(registry, sources, NULL, &error);
+    /* never read the card through a book of some other backend */
+    backend = e_source_get_extension(source, E_SOURCE_EXTENSION_ADDRESS_BOOK);
 
-      g_list_free(sources);
-    }
-
-    if (error)
+    if (g_strcmp0(e_source_backend_get_backend_name(backend),
+                  roster_backend_name()))
     {
-      OSSO_ABOOK_WARN("Creating ESource for uid %s failed - %s", uid,
-                      error->message);
-      g_clear_error(&error);
-
-      if (source)
-      {
-        g_object_unref(source);
-        source = NULL;
-      }
+      OSSO_ABOOK_WARN("SIM book %s has backend %s, not using it", _uid,
+                      e_source_backend_get_backend_name(backend));
+      g_object_unref(source);
+      source = NULL;
+      *foreign = TRUE;
     }
   }
 
-  g_object_unref(registry);
-
-err_out:
-
   g_free(_uid);
 
   return source;
 }
 
+/* Every book is done, whatever was cached and not found on the card is stale */
+static void
+save_cache(OssoABookSimGroup *sim_group)
+{
+  OssoABookSimGroupPrivate *priv = OSSO_ABOOK_SIM_GROUP_PRIVATE(sim_group);
+  GError *error = NULL;
+
+  drop_cached_contacts(priv->contact_model, &priv->cached_adn);
+  drop_cached_contacts(priv->contact_model, &priv->cached_sdn);
+
+  if (!priv->card)
+    return;
+
+  /* no IMSI if the card could not be read */
+  if (sim_cache_get_imsi(priv->card) &&
+      !sim_cache_save(priv->card, &error))
+  {
+    OSSO_ABOOK_WARN("Cannot save SIM cache: %s", error->message);
+    g_clear_error(&error);
+  }
+
+  sim_cache_free(priv->card);
+  priv->card = NULL;
+}
+
 static void
 osso_abook_sim_group_waitable_notify(OssoABookSimGroup *sim_group)
 {
@@ -515,6 +759,10 @@ osso_abook_sim_group_waitable_notify(OssoABookSimGroup *sim_group)
 
   if (priv->aggregator_num == 0)
   {
+    OSSO_ABOOK_NOTE(EDS, "SIM group ready in %.3f s",
+                    (g_get_monotonic_time() - priv->start_time) /
+                    (gdouble)G_USEC_PER_SEC);
+    save_cache(sim_group);
     osso_abook_waitable_notify(OSSO_ABOOK_WAITABLE(sim_group), NULL);
   }
 }
@@ -533,7 +781,7 @@ ebook_status_cb(OssoABookAggregator *aggregator, EBookStatus status,
   OssoABookSimGroupPrivate *priv = OSSO_ABOOK_SIM_GROUP_PRIVATE(sim_group);
   const char *uid;
 
-  uid = osso_abook_roster_get_book_uri(OSSO_ABOOK_ROSTER(aggregator));
+  uid = roster_book_name(OSSO_ABOOK_ROSTER(aggregator));
 
   g_return_val_if_fail(uid != NULL, FALSE);
 
@@ -566,12 +814,95 @@ aggregator_ready_cb(OssoABookWaitable *waitable, const GError *error,
   osso_abook_sim_group_waitable_notify(data);
 }
 
+typedef struct
+{
+  OssoABookContact *contact;
+  /* normalised TEL and EMAIL values the contact has */
+  GHashTable *values;
+} merged_contact;
+
+/* key is reused between calls, looking a value up allocates nothing */
+static const gchar *
+merge_key(GString *key, const char *attr_name, const char *value)
+{
+  gboolean tel = !g_strcmp0(attr_name, "TEL");
+  const char *p;
+
+  g_string_assign(key, tel ? "T" : "E");
+
+  for (p = value; *p; p++)
+  {
+    /* spaces, dashes and brackets don't make a number different */
+    if (!tel || g_ascii_isdigit(*p) || strchr("+*#pPwW", *p))
+      g_string_append_c(key, g_ascii_tolower(*p));
+  }
+
+  return key->str;
+}
+
+static gboolean
+is_merged_attribute(EVCardAttribute *attr, const char **value)
+{
+  const char *attr_name = e_vcard_attribute_get_name(attr);
+
+  if (!g_strcmp0(attr_name, "TEL") || !g_strcmp0(attr_name, "EMAIL"))
+  {
+    GList *val = e_vcard_attribute_get_values(attr);
+
+    if (val && val->data && *(const char *)val->data)
+    {
+      *value = val->data;
+
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+static merged_contact *
+merged_contact_new(OssoABookContact *contact, GString *key)
+{
+  merged_contact *merged = g_slice_new(merged_contact);
+  GList *attr;
+
+  merged->contact = g_object_ref(contact);
+  merged->values = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                         NULL);
+
+  for (attr = e_vcard_get_attributes(E_VCARD(contact)); attr;
+       attr = attr->next)
+  {
+    const char *value;
+
+    if (is_merged_attribute(attr->data, &value))
+    {
+      g_hash_table_add(
+            merged->values,
+            g_strdup(merge_key(key, e_vcard_attribute_get_name(attr->data),
+                               value)));
+    }
+  }
+
+  return merged;
+}
+
+static void
+merged_contact_free(merged_contact *merged)
+{
+  g_object_unref(merged->contact);
+  g_hash_table_destroy(merged->values);
+  g_slice_free(merged_contact, merged);
+}
+
 #define E_VCARD_FLD_ID(attr) \
   e_contact_field_id_from_vcard(e_vcard_attribute_get_name(attr))
 
 static gboolean
-_copy_sim_contact_details(EContact *dest_contact, EContact *source_contact)
+_copy_sim_contact_details(merged_contact *dest, EContact *source_contact,
+                          GString *key)
 {
+  EContact *dest_contact = E_CONTACT(dest->contact);
   GList *src_attr;
   gboolean copied = FALSE;
 
@@ -582,33 +913,18 @@ _copy_sim_contact_details(EContact *dest_contact, EContact *source_contact)
        src_attr = src_attr->next)
   {
     const char *attr_name = e_vcard_attribute_get_name(src_attr->data);
+    const char *value;
 
-    if (!g_strcmp0(attr_name, "TEL") || !g_strcmp0(attr_name, "EMAIL"))
+    if (is_merged_attribute(src_attr->data, &value))
     {
-      GList *val = e_vcard_attribute_get_values(src_attr->data);
+      const gchar *k = merge_key(key, attr_name, value);
 
-      if (val && val->data && *(const char *)val->data)
+      if (!g_hash_table_contains(dest->values, k))
       {
-        GList *attr = e_contact_get_attributes(dest_contact,
-                                               E_VCARD_FLD_ID(src_attr->data));
-        GList *a;
-
-        for (a = attr; a; a = a->next)
-        {
-          GList *dest_val = e_vcard_attribute_get_values(a->data);
-
-          if (!g_strcmp0(dest_val->data, val->data))
-            break;
-        }
-
-        if (!a)
-        {
-          e_vcard_add_attribute(E_VCARD(dest_contact),
-                                e_vcard_attribute_copy(src_attr->data));
-          copied = TRUE;
-        }
-
-        g_list_free_full(attr, (GDestroyNotify)e_vcard_attribute_free);
+        e_vcard_add_attribute(E_VCARD(dest_contact),
+                              e_vcard_attribute_copy(src_attr->data));
+        g_hash_table_add(dest->values, g_strdup(k));
+        copied = TRUE;
       }
     }
     else if (!g_strcmp0(attr_name, "NICKNAME"))
@@ -639,12 +955,13 @@ contacts_added_cb(OssoABookRoster *roster, OssoABookContact **contacts,
 {
   OssoABookSimGroup *sim_group = OSSO_ABOOK_SIM_GROUP(user_data);
   OssoABookSimGroupPrivate *priv = OSSO_ABOOK_SIM_GROUP_PRIVATE(sim_group);
-  const char *uid = osso_abook_roster_get_book_uri(roster);
+  const char *uid = roster_book_name(roster);
 
   g_return_if_fail(uid != NULL);
 
   if (!strcmp(uid, "adn"))
   {
+    GString *key = g_string_sized_new(32);
     OssoABookContact *c;
 
     while((c = *contacts))
@@ -653,18 +970,18 @@ contacts_added_cb(OssoABookRoster *roster, OssoABookContact **contacts,
                                                   E_CONTACT_FULL_NAME);
       if (full_name)
       {
-        OssoABookContact *existing_contact =
+        merged_contact *existing_contact =
             g_hash_table_lookup(priv->contacts_by_full_name, full_name);
 
         if (existing_contact)
-          _copy_sim_contact_details(E_CONTACT(existing_contact), E_CONTACT(c));
+          _copy_sim_contact_details(existing_contact, E_CONTACT(c), key);
         else
         {
           priv->adn_contacts =
               g_slist_prepend(priv->adn_contacts, g_object_ref(c));
 
           g_hash_table_insert(priv->contacts_by_full_name, g_strdup(full_name),
-                              g_object_ref(c));
+                              merged_contact_new(c, key));
         }
       }
       else
@@ -672,9 +989,11 @@ contacts_added_cb(OssoABookRoster *roster, OssoABookContact **contacts,
         priv->adn_contacts =
             g_slist_prepend(priv->adn_contacts, g_object_ref(c));
       }
+
+      contacts++;
     }
 
-    contacts++;
+    g_string_free(key, TRUE);
   }
   else if (!strcmp(uid, "sdn"))
   {
@@ -689,6 +1008,13 @@ contacts_added_cb(OssoABookRoster *roster, OssoABookContact **contacts,
   }
   else if (!strcmp(uid, "mbdn") || !strcmp(uid, "vmbx"))
   {
+    /* the card has the numbers now */
+    if (priv->vmbx_cached)
+    {
+      e_vcard_remove_attributes(E_VCARD(priv->vmbx_contact), NULL, "TEL");
+      priv->vmbx_cached = FALSE;
+    }
+
     if (!priv->vmbx_contact)
     {
       priv->vmbx_contact =
@@ -713,9 +1039,269 @@ contacts_added_cb(OssoABookRoster *roster, OssoABookContact **contacts,
   }
 }
 
+static GHashTable *
+serve_cached_contacts(OssoABookSimGroupPrivate *priv, sim_cache *cache,
+                      const char *book)
+{
+  gchar **vcards = sim_cache_get_list(cache, book);
+  GHashTable *served;
+  GList *rows = NULL;
+  gchar **vcard;
+
+  if (!vcards)
+    return NULL;
+
+  served = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                 g_object_unref);
+
+  for (vcard = vcards; *vcard; vcard++)
+  {
+    OssoABookContact *contact = osso_abook_contact_new_from_vcard(NULL,
+                                                                  *vcard);
+
+    rows = g_list_prepend(rows, osso_abook_list_store_row_new(contact));
+    g_hash_table_replace(served, g_strdup(*vcard), contact);
+  }
+
+  osso_abook_list_store_merge_rows(OSSO_ABOOK_LIST_STORE(priv->contact_model),
+                                   rows);
+  g_list_free(rows);
+  g_strfreev(vcards);
+
+  return served;
+}
+
+/* The limits come with the phonebook, until that is read they are the ones of
+ * last time */
 static void
-osso_abook_sim_group_init(OssoABookSimGroup *sim_group)
+serve_cached_capabilities(struct sim_group_capabilities *capabilities,
+                          sim_cache *cache)
+{
+  if (capabilities->max_num_of_entries)
+    return;
+
+  capabilities->max_num_of_entries =
+      sim_cache_get_capability(cache, "max_num_of_entries");
+  capabilities->max_num_of_sne_entries =
+      sim_cache_get_capability(cache, "max_num_of_sne_entries");
+  capabilities->max_num_of_email_entries =
+      sim_cache_get_capability(cache, "max_num_of_email_entries");
+}
+
+/* The contacts of the card as they were last time are there before the card
+ * is read, the card read only touches the model if something has changed. */
+static gboolean
+load_cache(OssoABookSimGroup *sim_group, const gchar *imsi)
 {
+  OssoABookSimGroupPrivate *priv = OSSO_ABOOK_SIM_GROUP_PRIVATE(sim_group);
+  sim_cache *cache = sim_cache_load(imsi);
+  gchar **numbers;
+
+  if (!cache)
+    return FALSE;
+
+  OSSO_ABOOK_NOTE(EDS, "serving SIM contacts cached for %s", imsi);
+
+  serve_cached_capabilities(priv->capabilities, cache);
+  priv->cached_adn = serve_cached_contacts(priv, cache, "adn");
+  priv->cached_sdn = serve_cached_contacts(priv, cache, "sdn");
+
+  numbers = sim_cache_get_list(cache, "mbdn");
+
+  if (numbers && *numbers)
+  {
+    gchar **number;
+
+    priv->vmbx_contact =
+        create_sim_contact(priv->contact_model,
+                           dgettext(NULL, "addr_fi_voicemailbox"),
+                           "osso-abook-vmbx");
+
+    for (number = numbers; *number; number++)
+    {
+      e_vcard_add_attribute_with_value(E_VCARD(priv->vmbx_contact),
+                                       e_vcard_attribute_new(0, "TEL"),
+                                       *number);
+    }
+
+    priv->vmbx_cached = TRUE;
+  }
+
+  g_strfreev(numbers);
+  sim_cache_free(cache);
+
+  return TRUE;
+}
+
+/* The first book that opens tells which card is in, nothing is served before
+ * that, so a swapped card never shows the contacts of the previous one */
+static void
+identify_card(OssoABookSimGroup *sim_group, EBook *book)
+{
+  OssoABookSimGroupPrivate *priv = OSSO_ABOOK_SIM_GROUP_PRIVATE(sim_group);
+
+  priv->capabilities = osso_abook_sim_capabilities_new(book);
+
+  if (!priv->capabilities || !priv->capabilities->imsi)
+    return;
+
+  if (load_cache(sim_group, priv->capabilities->imsi))
+  {
+    g_signal_emit(G_OBJECT(sim_group), signals[AVAILABLE], 0);
+    g_signal_emit(G_OBJECT(sim_group), signals[CAPABILITIES_AVAILABLE], 0);
+  }
+
+  if (priv->card)
+    cache_capabilities(priv->card, priv->capabilities);
+}
+
+typedef struct
+{
+  OssoABookSimGroup *sim_group;
+  EBook *book;
+  gchar *uid;
+} open_book_data;
+
+static void
+book_open_cb(EBook *book, const GError *error, gpointer closure)
+{
+  open_book_data *data = closure;
+  OssoABookSimGroup *sim_group = data->sim_group;
+  OssoABookSimGroupPrivate *priv = OSSO_ABOOK_SIM_GROUP_PRIVATE(sim_group);
+
+  if (error)
+  {
+    OSSO_ABOOK_WARN("Cannot create SIM address book for (%s): %s", data->uid,
+                    error->message);
+    osso_abook_sim_group_waitable_notify(sim_group);
+  }
+  else if (!g_cancellable_is_cancelled(priv->cancellable))
+  {
+    OssoABookRoster *aggregator;
+
+    if (!priv->capabilities)
+      identify_card(sim_group, book);
+
+    aggregator = osso_abook_aggregator_new(book, NULL);
+
+    osso_abook_aggregator_set_roster_manager(
+          OSSO_ABOOK_AGGREGATOR(aggregator), NULL);
+
+    g_hash_table_insert(priv->aggregators, g_strdup(data->uid), aggregator);
+
+    g_signal_connect(aggregator, "contacts-added",
+                     G_CALLBACK(contacts_added_cb), sim_group);
+    g_signal_connect(aggregator, "sequence-complete",
+                     G_CALLBACK(sequence_complete_cb), sim_group);
+    g_signal_connect(aggregator, "notify::book-view",
+                     G_CALLBACK(book_view_changed_cb), sim_group);
+    g_signal_connect(aggregator, "ebook-status",
+                     G_CALLBACK(ebook_status_cb), sim_group);
+
+    osso_abook_roster_start(aggregator);
+    osso_abook_waitable_call_when_ready(OSSO_ABOOK_WAITABLE(aggregator),
+                                        aggregator_ready_cb, sim_group,
+                                        NULL);
+  }
+
+  g_object_unref(book);
+  g_object_unref(sim_group);
+  g_free(data->uid);
+  g_slice_free(open_book_data, data);
+}
+
+static gboolean
+open_book_timeout_cb(gpointer user_data)
+{
+  open_book_data *data = user_data;
+
+  e_book_open_async(data->book, TRUE, book_open_cb, data);
+
+  return FALSE;
+}
+
+/* the books are opened in parallel, the one that counts as pending for the
+ * waitable is only released once its aggregator is ready */
+static void
+open_roster_book(OssoABookSimGroup *sim_group, ESource *source,
+                 const gchar *uid)
+{
+  GError *error = NULL;
+  EBook *book = e_book_new(source, &error);
+  open_book_data *data;
+
+  if (!book)
+  {
+    OSSO_ABOOK_WARN("Cannot create SIM address book for (%s): %s", uid,
+                    error->message);
+    g_clear_error(&error);
+    osso_abook_sim_group_waitable_notify(sim_group);
+
+    return;
+  }
+
+  data = g_slice_new(open_book_data);
+  data->sim_group = g_object_ref(sim_group);
+  data->book = book;
+  data->uid = g_strdup(uid);
+
+  /* a modem takes a while */
+  if (fake_sim_latency())
+    g_timeout_add(fake_sim_latency(), open_book_timeout_cb, data);
+  else
+    e_book_open_async(book, TRUE, book_open_cb, data);
+}
+
+typedef struct
+{
+  OssoABookSimGroup *sim_group;
+  GList *sources;
+} create_sources_data;
+
+static void
+sources_created_cb(GObject *source_object, GAsyncResult *res,
+                   gpointer user_data)
+{
+  create_sources_data *data = user_data;
+  OssoABookSimGroup *sim_group = data->sim_group;
+  OssoABookSimGroupPrivate *priv = OSSO_ABOOK_SIM_GROUP_PRIVATE(sim_group);
+  GError *error = NULL;
+  gboolean created;
+  GList *l;
+
+  created = e_source_registry_create_sources_finish(
+        E_SOURCE_REGISTRY(source_object), res, &error);
+
+  if (!created)
+  {
+    OSSO_ABOOK_WARN("Creating SIM ESources failed - %s", error->message);
+    g_clear_error(&error);
+  }
+
+  for (l = data->sources; l; l = l->next)
+  {
+    ESourceResource *resource =
+        e_source_get_extension(l->data, E_SOURCE_EXTENSION_RESOURCE);
+
+    if (created && !g_cancellable_is_cancelled(priv->cancellable))
+    {
+      open_roster_book(sim_group, l->data,
+                       e_source_resource_get_identity(resource));
+    }
+    else
+      osso_abook_sim_group_waitable_notify(sim_group);
+  }
+
+  g_list_free_full(data->sources, g_object_unref);
+  g_slice_free(create_sources_data, data);
+  g_object_unref(sim_group);
+}
+
+static void
+registry_ready_cb(GObject *source_object, GAsyncResult *res,
+                  gpointer user_data)
+{
+  OssoABookSimGroup *sim_group = user_data;
   OssoABookSimGroupPrivate *priv = OSSO_ABOOK_SIM_GROUP_PRIVATE(sim_group);
   static const char *uids[] =
   {
@@ -726,62 +1312,91 @@ osso_abook_sim_group_init(OssoABookSimGroup *sim_group)
     "en",
     NULL
   };
-  const char **uid = uids;
+  const char **uid;
+  GList *new_sources = NULL;
+  GError *error = NULL;
+  ESourceRegistry *registry = e_source_registry_new_finish(res, &error);
 
-  priv->contact_model = osso_abook_contact_model_new();
-  priv->closures = g_queue_new();
-  priv->aggregators =
-      g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_object_unref);
-  priv->contacts_by_full_name =
-      g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_object_unref);
+  if (!registry)
+  {
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      OSSO_ABOOK_WARN("Creating ESourceRegistry for SIM books failed - %s",
+                      error->message);
+      osso_abook_sim_group_waitable_notify(sim_group);
+    }
+
+    g_clear_error(&error);
+    g_object_unref(sim_group);
+
+    return;
+  }
+
+  priv->registry = registry;
 
-  while (*uid)
+  for (uid = uids; *uid; uid++)
   {
-      GError *error = NULL;
-      ESource *source = create_roster_source(*uid);
+    gboolean foreign;
+    ESource *source = lookup_roster_source(registry, *uid, &foreign);
+
+    /* its UID is taken, so the book cannot be created either */
+    if (foreign)
+      continue;
+
+    if (!source)
+    {
+      source = create_roster_source(*uid);
 
       if (source)
       {
+        priv->aggregator_num++;
+        new_sources = g_list_append(new_sources, source);
+      }
 
-        EBook *book = e_book_new(source, &error);
+      continue;
+    }
 
-        g_object_unref(source);
+    priv->aggregator_num++;
+    open_roster_book(sim_group, source, *uid);
+    g_object_unref(source);
+  }
 
-        if (book && e_book_open(book, TRUE, &error))
-        {
-          OssoABookRoster *aggregator = osso_abook_aggregator_new(book, NULL);
-
-          osso_abook_aggregator_set_roster_manager(
-                OSSO_ABOOK_AGGREGATOR(aggregator), NULL);
-          g_object_unref(book);
-
-          g_hash_table_insert(priv->aggregators, g_strdup(*uid), aggregator);
-
-          g_signal_connect(aggregator, "contacts-added",
-                           G_CALLBACK(contacts_added_cb), sim_group);
-          g_signal_connect(aggregator, "sequence-complete",
-                           G_CALLBACK(sequence_complete_cb), sim_group);
-          g_signal_connect(aggregator, "notify::book-view",
-                           G_CALLBACK(book_view_changed_cb), sim_group);
-          g_signal_connect(aggregator, "ebook-status",
-                           G_CALLBACK(ebook_status_cb), sim_group);
-
-          osso_abook_roster_start(aggregator);
-          priv->aggregator_num++;
-          osso_abook_waitable_call_when_ready(OSSO_ABOOK_WAITABLE(aggregator),
-                                              aggregator_ready_cb, sim_group,
-                                              NULL);
-        }
-        else
-        {
-          OSSO_ABOOK_WARN("Cannot create SIM address book for (%s): %s", *uid,
-                          error->message);
-          g_clear_error(&error);
-        }
-      }
+  /* all of them in one go, the first time the SIM is used */
+  if (new_sources)
+  {
+    create_sources_data *data = g_slice_new(create_sources_data);
 
-      uid++;
+    data->sim_group = g_object_ref(sim_group);
+    data->sources = new_sources;
+    e_source_registry_create_sources(registry, new_sources, priv->cancellable,
+                                     sources_created_cb, data);
   }
+
+  osso_abook_sim_group_waitable_notify(sim_group);
+  g_object_unref(sim_group);
+}
+
+static void
+osso_abook_sim_group_init(OssoABookSimGroup *sim_group)
+{
+  OssoABookSimGroupPrivate *priv = OSSO_ABOOK_SIM_GROUP_PRIVATE(sim_group);
+
+  priv->contact_model = osso_abook_contact_model_new();
+  priv->closures = g_queue_new();
+  priv->aggregators =
+      g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_object_unref);
+  priv->contacts_by_full_name =
+      g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                            (GDestroyNotify)merged_contact_free);
+
+  priv->start_time = g_get_monotonic_time();
+  priv->card = sim_cache_new();
+
+  /* not ready until the registry tells which books to open */
+  priv->aggregator_num = 1;
+  priv->cancellable = g_cancellable_new();
+  e_source_registry_new(priv->cancellable, registry_ready_cb,
+                        g_object_ref(sim_group));
 }
 
 OssoABookGroup *
@@ -825,8 +1440,38 @@ osso_abook_sim_group_list_adn_contacts(OssoABookSimGroup *sim_group)
 
   priv = OSSO_ABOOK_SIM_GROUP_PRIVATE(sim_group);
 
+  /* until the card is read, what it had last time */
+  if (priv->cached_adn)
+    return g_hash_table_get_values(priv->cached_adn);
+
   aggregator = g_hash_table_lookup(priv->aggregators, "adn");
   g_return_val_if_fail(aggregator, NULL);
 
   return osso_abook_aggregator_list_master_contacts(aggregator);
 }
+
+/* FALSE until the capabilities of the card are known */
+gboolean
+osso_abook_sim_group_get_limits(OssoABookSimGroup *sim_group, int *max_entries,
+                                int *max_sne_entries, int *max_email_entries)
+{
+  OssoABookSimGroupPrivate *priv;
+
+  g_return_val_if_fail(OSSO_ABOOK_IS_SIM_GROUP(sim_group), FALSE);
+
+  priv = OSSO_ABOOK_SIM_GROUP_PRIVATE(sim_group);
+
+  if (!priv->capabilities)
+    return FALSE;
+
+  if (max_entries)
+    *max_entries = priv->capabilities->max_num_of_entries;
+
+  if (max_sne_entries)
+    *max_sne_entries = priv->capabilities->max_num_of_sne_entries;
+
+  if (max_email_entries)
+    *max_email_entries = priv->capabilities->max_num_of_email_entries;
+
+  return TRUE;
+}
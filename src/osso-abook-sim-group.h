@@ -45,6 +45,10 @@ G_BEGIN_DECLS
                  OSSO_ABOOK_TYPE_SIM_GROUP, \
                  OssoABookSimGroupClass))
 
+/* With OSSO_ABOOK_FAKE_SIM set the SIM books are local ones, with UIDs like
+ * "fake-adn", so they never get mixed up with the books of a real card */
+#define OSSO_ABOOK_FAKE_SIM_UID_PREFIX "fake-"
+
 typedef struct _OssoABookSimGroupClass OssoABookSimGroupClass;
 typedef struct _OssoABookSimGroup OssoABookSimGroup;
 
@@ -77,6 +81,10 @@ osso_abook_sim_group_get_imsi(OssoABookSimGroup *sim_group);
 GList *
 osso_abook_sim_group_list_adn_contacts(OssoABookSimGroup *sim_group);
 
+gboolean
+osso_abook_sim_group_get_limits(OssoABookSimGroup *sim_group, int *max_entries,
+                                int *max_sne_entries, int *max_email_entries);
+
 G_END_DECLS
 
 #endif // OSSOABOOKSIMGROUP_H
@@ -0,0 +1,852 @@
+/*
+ * restore-engine.c
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <libebook/libebook.h>
+#include <libosso-abook/osso-abook-log.h>
+
+#include <string.h>
+
+#include "backup-store.h"
+#include "vcard-tokenizer.h"
+
+#include "restore-engine.h"
+
+#define CONTACTS_PER_BATCH 200
+
+typedef struct
+{
+  /* NULL for the system book */
+  gchar *uid;
+
+  /* how to create the book again, from the manifest */
+  gchar *backend;
+  gchar *parent;
+  gchar *name;
+  GPtrArray *contacts;
+} restore_book;
+
+/* The snapshot is loaded and verified in a worker thread, then the books are
+ * restored one after another, in batches */
+struct _restore_engine
+{
+  gchar *path;
+  gchar *generation;
+  GCancellable *cancellable;
+  restore_engine_done_cb cb;
+  gpointer user_data;
+  GError *error;
+
+  GPtrArray *books;
+  guint book;
+  guint next_contact;
+  guint batch_len;
+  ESourceRegistry *registry;
+  ESource *new_source;
+  EBookClient *client;
+
+  gint64 start_time;
+  gint64 end_time;
+  int total_contacts;
+  int restored_contacts;
+  int restored_books;
+  int skipped_books;
+  int skipped_contacts;
+};
+
+static void
+restore_next_book(restore_engine *engine);
+
+static void
+restore_book_free(restore_book *book)
+{
+  g_ptr_array_free(book->contacts, TRUE);
+  g_free(book->uid);
+  g_free(book->backend);
+  g_free(book->parent);
+  g_free(book->name);
+  g_free(book);
+}
+
+static restore_book *
+restore_book_new(const gchar *uid)
+{
+  restore_book *book = g_new0(restore_book, 1);
+
+  book->uid = g_strdup(uid);
+  book->contacts = g_ptr_array_new_with_free_func(g_object_unref);
+
+  return book;
+}
+
+restore_engine *
+restore_engine_new(const gchar *path, const gchar *generation,
+                   restore_engine_done_cb cb, gpointer user_data)
+{
+  restore_engine *engine;
+
+  g_return_val_if_fail(path != NULL, NULL);
+
+  engine = g_new0(restore_engine, 1);
+  engine->path = g_strdup(path);
+  engine->generation = g_strdup(generation);
+  engine->cb = cb;
+  engine->user_data = user_data;
+  engine->cancellable = g_cancellable_new();
+
+  return engine;
+}
+
+void
+restore_engine_free(restore_engine *engine)
+{
+  if (!engine)
+    return;
+
+  if (engine->books)
+    g_ptr_array_free(engine->books, TRUE);
+
+  if (engine->client)
+    g_object_unref(engine->client);
+
+  if (engine->new_source)
+    g_object_unref(engine->new_source);
+
+  if (engine->registry)
+    g_object_unref(engine->registry);
+
+  g_clear_error(&engine->error);
+  g_object_unref(engine->cancellable);
+  g_free(engine->generation);
+  g_free(engine->path);
+  g_free(engine);
+}
+
+void
+restore_engine_cancel(restore_engine *engine)
+{
+  g_return_if_fail(engine != NULL);
+
+  g_cancellable_cancel(engine->cancellable);
+}
+
+gdouble
+restore_engine_get_progress(restore_engine *engine)
+{
+  g_return_val_if_fail(engine != NULL, 0.0);
+
+  if (!engine->total_contacts)
+    return 0.0;
+
+  return (gdouble)engine->restored_contacts / engine->total_contacts;
+}
+
+void
+restore_engine_get_stats(restore_engine *engine, restore_stats *stats)
+{
+  g_return_if_fail(engine != NULL);
+  g_return_if_fail(stats != NULL);
+
+  stats->elapsed = (engine->end_time ? engine->end_time :
+                    g_get_monotonic_time()) - engine->start_time;
+  stats->books = engine->restored_books;
+  stats->total_contacts = engine->total_contacts;
+  stats->restored_contacts = engine->restored_contacts;
+  stats->skipped_books = engine->skipped_books;
+  stats->skipped_contacts = engine->skipped_contacts;
+}
+
+const GError *
+restore_engine_get_error(restore_engine *engine)
+{
+  g_return_val_if_fail(engine != NULL, NULL);
+
+  return engine->error;
+}
+
+static void
+restore_set_error(restore_engine *engine, GError *error)
+{
+  if (!engine->error)
+    engine->error = error;
+  else
+    g_error_free(error);
+}
+
+/* Puts the photos the backup moved to blobs back in the vCard */
+static gboolean
+restore_inline_blobs(backup_store *store, EContact *contact, GError **error)
+{
+  GList *l;
+
+  for (l = e_vcard_get_attributes(E_VCARD(contact)); l; l = l->next)
+  {
+    EVCardAttribute *attr = l->data;
+    const char *name = e_vcard_attribute_get_name(attr);
+    GList *types;
+    gchar *type = NULL;
+    gchar *value;
+    GBytes *blob;
+
+    if (g_ascii_strcasecmp(name, EVC_PHOTO) &&
+        g_ascii_strcasecmp(name, EVC_LOGO))
+    {
+      continue;
+    }
+
+    value = e_vcard_attribute_get_value(attr);
+
+    if (!value || !g_str_has_prefix(value, BACKUP_BLOB_SCHEME))
+    {
+      g_free(value);
+      continue;
+    }
+
+    /* a missing or damaged photo fails the restore like any other object */
+    blob = backup_store_get(store, value + strlen(BACKUP_BLOB_SCHEME), error);
+    g_free(value);
+
+    if (!blob)
+      return FALSE;
+
+    types = e_vcard_attribute_get_param(attr, EVC_TYPE);
+
+    if (types)
+      type = g_strdup(types->data);
+
+    e_vcard_attribute_remove_params(attr);
+    e_vcard_attribute_remove_values(attr);
+    e_vcard_attribute_add_param_with_value(
+          attr, e_vcard_attribute_param_new(EVC_ENCODING), "b");
+
+    if (type)
+    {
+      e_vcard_attribute_add_param_with_value(
+            attr, e_vcard_attribute_param_new(EVC_TYPE), type);
+    }
+
+    e_vcard_attribute_add_value_decoded(attr, g_bytes_get_data(blob, NULL),
+                                        g_bytes_get_size(blob));
+    g_bytes_unref(blob);
+    g_free(type);
+  }
+
+  return TRUE;
+}
+
+static restore_book *
+restore_load_book(backup_store *store, GKeyFile *manifest,
+                  const gchar *generation, const gchar *uid, GError **error)
+{
+  restore_book *book;
+  gchar **lines;
+  gchar **line;
+  int expected;
+
+  lines = backup_store_read_index(store, generation, uid, error);
+
+  if (!lines)
+    return NULL;
+
+  book = restore_book_new(uid);
+  book->backend = g_key_file_get_string(manifest, uid, "backend", NULL);
+  book->parent = g_key_file_get_string(manifest, uid, "parent", NULL);
+  book->name = g_key_file_get_string(manifest, uid, "name", NULL);
+
+  for (line = lines; *line; line++)
+  {
+    gchar *hash = g_strndup(*line, strcspn(*line, " "));
+    GBytes *object = backup_store_get(store, hash, error);
+    EContact *contact;
+    gchar *vcard;
+
+    g_free(hash);
+
+    if (!object)
+      goto err;
+
+    vcard = g_strndup(g_bytes_get_data(object, NULL),
+                      g_bytes_get_size(object));
+    g_bytes_unref(object);
+    contact = e_contact_new_from_vcard(vcard);
+    g_free(vcard);
+    g_ptr_array_add(book->contacts, contact);
+
+    if (!restore_inline_blobs(store, contact, error))
+      goto err;
+  }
+
+  expected = g_key_file_get_integer(manifest, uid, "contacts", NULL);
+
+  if (book->contacts->len != (guint)expected)
+  {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                "Book %s has %d contacts in backup %s, instead of %d", uid,
+                book->contacts->len, generation, expected);
+    goto err;
+  }
+
+  g_strfreev(lines);
+
+  return book;
+
+err:
+  g_strfreev(lines);
+  restore_book_free(book);
+
+  return NULL;
+}
+
+static GPtrArray *
+restore_load_store(const gchar *path, const gchar *generation, GError **error)
+{
+  backup_store *store = backup_store_open(path, error);
+  GPtrArray *books = NULL;
+  GKeyFile *manifest = NULL;
+  gchar **generations = NULL;
+  gchar **uids = NULL;
+  gchar **uid;
+  int version;
+
+  if (!store)
+    return NULL;
+
+  if (!generation)
+  {
+    generations = backup_store_list_generations(store);
+    generation = generations[0] ?
+      generations[g_strv_length(generations) - 1] : NULL;
+  }
+
+  if (!generation)
+  {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT,
+                "No complete backup in %s", path);
+    goto out;
+  }
+
+  manifest = backup_store_load_generation(store, generation, error);
+
+  if (!manifest)
+    goto out;
+
+  version = g_key_file_get_integer(manifest, BACKUP_MANIFEST_GROUP, "version",
+                                   NULL);
+
+  if (version < 1 || version > BACKUP_VERSION)
+  {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                "Backup %s has unsupported version %d", generation, version);
+    goto out;
+  }
+
+  OSSO_ABOOK_NOTE(GENERIC, "restoring backup %s", generation);
+
+  uids = g_key_file_get_string_list(manifest, BACKUP_MANIFEST_GROUP, "books",
+                                    NULL, NULL);
+  books = g_ptr_array_new_with_free_func((GDestroyNotify)restore_book_free);
+
+  for (uid = uids; uid && *uid; uid++)
+  {
+    restore_book *book = restore_load_book(store, manifest, generation, *uid,
+                                           error);
+
+    if (!book)
+    {
+      g_ptr_array_free(books, TRUE);
+      books = NULL;
+      break;
+    }
+
+    g_ptr_array_add(books, book);
+  }
+
+out:
+  g_strfreev(uids);
+  g_strfreev(generations);
+
+  if (manifest)
+    g_key_file_free(manifest);
+
+  backup_store_free(store);
+
+  return books;
+}
+
+/* An export, as written by the exporter or osso-addressbook-batch */
+static GPtrArray *
+restore_load_vcards(const gchar *path, GError **error)
+{
+  vcard_tokenizer *tokenizer;
+  restore_book *book;
+  GPtrArray *books;
+  const gchar *card;
+  gchar *contents;
+  gsize len;
+
+  if (!g_file_get_contents(path, &contents, &len, error))
+    return NULL;
+
+  tokenizer = vcard_tokenizer_new();
+  vcard_tokenizer_feed(tokenizer, contents, len);
+  vcard_tokenizer_close(tokenizer);
+  g_free(contents);
+  book = restore_book_new(NULL);
+
+  while (vcard_tokenizer_next(tokenizer, &card, &len))
+  {
+    gchar *vcard = g_strndup(card, len);
+
+    g_ptr_array_add(book->contacts, e_contact_new_from_vcard(vcard));
+    g_free(vcard);
+  }
+
+  /* a card that never ends, the file got cut */
+  if (vcard_tokenizer_get_pending(tokenizer))
+  {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                "%s is truncated after %d contacts", path,
+                book->contacts->len);
+    vcard_tokenizer_free(tokenizer);
+    restore_book_free(book);
+
+    return NULL;
+  }
+
+  vcard_tokenizer_free(tokenizer);
+  books = g_ptr_array_new_with_free_func((GDestroyNotify)restore_book_free);
+  g_ptr_array_add(books, book);
+
+  return books;
+}
+
+static void
+restore_load_thread(GTask *task, gpointer source_object, gpointer task_data,
+                    GCancellable *cancellable)
+{
+  restore_engine *engine = task_data;
+  GError *error = NULL;
+  GPtrArray *books;
+
+  if (g_file_test(engine->path, G_FILE_TEST_IS_DIR))
+    books = restore_load_store(engine->path, engine->generation, &error);
+  else
+    books = restore_load_vcards(engine->path, &error);
+
+  if (books)
+    g_task_return_pointer(task, books, (GDestroyNotify)g_ptr_array_unref);
+  else
+    g_task_return_error(task, error);
+}
+
+static gboolean
+restore_done_cb(gpointer user_data)
+{
+  restore_engine *engine = user_data;
+
+  if (engine->cb)
+    engine->cb(engine, engine->user_data);
+
+  return FALSE;
+}
+
+static void
+restore_finish(restore_engine *engine)
+{
+  if (!engine->error && g_cancellable_is_cancelled(engine->cancellable))
+  {
+    g_set_error_literal(&engine->error, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                        "Restore cancelled");
+  }
+
+  engine->end_time = g_get_monotonic_time();
+
+  if (engine->error)
+    OSSO_ABOOK_WARN("Restore failed: %s", engine->error->message);
+  else
+  {
+    OSSO_ABOOK_NOTE(GENERIC, "restored %d contacts to %d books in %.2f s",
+                    engine->restored_contacts, engine->restored_books,
+                    (engine->end_time - engine->start_time) /
+                    (gdouble)G_USEC_PER_SEC);
+  }
+
+  g_idle_add(restore_done_cb, engine);
+}
+
+static restore_book *
+restore_current_book(restore_engine *engine)
+{
+  return g_ptr_array_index(engine->books, engine->book);
+}
+
+static void
+restore_book_done(restore_engine *engine)
+{
+  g_clear_object(&engine->client);
+  engine->book++;
+  restore_next_book(engine);
+}
+
+static void
+restore_verify_cb(GObject *source_object, GAsyncResult *res,
+                  gpointer user_data)
+{
+  restore_engine *engine = user_data;
+  restore_book *book = restore_current_book(engine);
+  GSList *uids = NULL;
+  GError *error = NULL;
+
+  if (!e_book_client_get_contacts_uids_finish(E_BOOK_CLIENT(source_object),
+                                              res, &uids, &error))
+  {
+    restore_set_error(engine, error);
+  }
+  else if (g_slist_length(uids) != book->contacts->len)
+  {
+    g_set_error(&engine->error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                "Book %s has %d contacts after the restore, instead of %d",
+                e_source_get_uid(e_client_get_source(E_CLIENT(source_object))),
+                g_slist_length(uids), book->contacts->len);
+  }
+  else
+    engine->restored_books++;
+
+  g_slist_free_full(uids, g_free);
+  restore_book_done(engine);
+}
+
+/* the book has to open and hold everything that was put in it */
+static void
+restore_verify(restore_engine *engine)
+{
+  EBookQuery *query = e_book_query_any_field_contains("");
+  gchar *sexp = e_book_query_to_string(query);
+
+  e_book_client_get_contacts_uids(engine->client, sexp, engine->cancellable,
+                                  restore_verify_cb, engine);
+  g_free(sexp);
+  e_book_query_unref(query);
+}
+
+static void
+restore_commit_batch(restore_engine *engine);
+
+static void
+restore_add_contacts_cb(GObject *source_object, GAsyncResult *res,
+                        gpointer user_data)
+{
+  restore_engine *engine = user_data;
+  GError *error = NULL;
+
+  if (!e_book_client_add_contacts_finish(E_BOOK_CLIENT(source_object), res,
+                                         NULL, &error))
+  {
+    restore_set_error(engine, error);
+    restore_book_done(engine);
+
+    return;
+  }
+
+  engine->restored_contacts += engine->batch_len;
+  restore_commit_batch(engine);
+}
+
+static void
+restore_commit_batch(restore_engine *engine)
+{
+  restore_book *book = restore_current_book(engine);
+  GSList *batch = NULL;
+  guint i;
+
+  if (engine->next_contact == book->contacts->len)
+  {
+    restore_verify(engine);
+
+    return;
+  }
+
+  for (i = MIN(engine->next_contact + CONTACTS_PER_BATCH,
+               book->contacts->len); i > engine->next_contact; i--)
+  {
+    batch = g_slist_prepend(batch, g_ptr_array_index(book->contacts, i - 1));
+  }
+
+  engine->batch_len = g_slist_length(batch);
+  engine->next_contact += engine->batch_len;
+
+  /* UIDs are kept, so master contacts still find their roster contacts */
+  e_book_client_add_contacts(engine->client, batch, E_BOOK_OPERATION_FLAG_NONE,
+                             engine->cancellable, restore_add_contacts_cb,
+                             engine);
+  g_slist_free(batch);
+}
+
+static void
+restore_remove_contacts_cb(GObject *source_object, GAsyncResult *res,
+                           gpointer user_data)
+{
+  restore_engine *engine = user_data;
+  GError *error = NULL;
+
+  if (!e_book_client_remove_contacts_finish(E_BOOK_CLIENT(source_object), res,
+                                            &error))
+  {
+    restore_set_error(engine, error);
+    restore_book_done(engine);
+
+    return;
+  }
+
+  engine->next_contact = 0;
+  restore_commit_batch(engine);
+}
+
+static void
+restore_get_uids_cb(GObject *source_object, GAsyncResult *res,
+                    gpointer user_data)
+{
+  restore_engine *engine = user_data;
+  GSList *uids = NULL;
+  GError *error = NULL;
+
+  if (!e_book_client_get_contacts_uids_finish(E_BOOK_CLIENT(source_object),
+                                              res, &uids, &error))
+  {
+    restore_set_error(engine, error);
+    restore_book_done(engine);
+
+    return;
+  }
+
+  OSSO_ABOOK_NOTE(GENERIC, "removing %d contacts from %s",
+                  g_slist_length(uids),
+                  e_source_get_uid(e_client_get_source(E_CLIENT(source_object))));
+
+  if (uids)
+  {
+    e_book_client_remove_contacts(engine->client, uids,
+                                  E_BOOK_OPERATION_FLAG_NONE,
+                                  engine->cancellable,
+                                  restore_remove_contacts_cb, engine);
+    g_slist_free_full(uids, g_free);
+  }
+  else
+  {
+    engine->next_contact = 0;
+    restore_commit_batch(engine);
+  }
+}
+
+static void
+restore_connect_cb(GObject *source_object, GAsyncResult *res,
+                   gpointer user_data)
+{
+  restore_engine *engine = user_data;
+  GError *error = NULL;
+  EClient *client = e_book_client_connect_finish(res, &error);
+  EBookQuery *query;
+  gchar *sexp;
+
+  if (!client)
+  {
+    restore_set_error(engine, error);
+    restore_book_done(engine);
+
+    return;
+  }
+
+  /* start from an empty book, whatever was in it */
+  engine->client = E_BOOK_CLIENT(client);
+  query = e_book_query_any_field_contains("");
+  sexp = e_book_query_to_string(query);
+  e_book_client_get_contacts_uids(engine->client, sexp, engine->cancellable,
+                                  restore_get_uids_cb, engine);
+  g_free(sexp);
+  e_book_query_unref(query);
+}
+
+static void
+restore_create_source_cb(GObject *source_object, GAsyncResult *res,
+                         gpointer user_data)
+{
+  restore_engine *engine = user_data;
+  ESource *source = engine->new_source;
+  GError *error = NULL;
+
+  engine->new_source = NULL;
+
+  if (!e_source_registry_create_sources_finish(
+        E_SOURCE_REGISTRY(source_object), res, &error))
+  {
+    restore_set_error(engine, error);
+    restore_book_done(engine);
+  }
+  else
+  {
+    e_book_client_connect(source, 30, engine->cancellable, restore_connect_cb,
+                          engine);
+  }
+
+  g_object_unref(source);
+}
+
+/* a local book that did not survive, a new device for example */
+static void
+restore_create_source(restore_engine *engine, restore_book *book)
+{
+  ESourceBackend *backend;
+  GError *error = NULL;
+  GList *sources;
+
+  engine->new_source = e_source_new_with_uid(book->uid, NULL, &error);
+
+  if (!engine->new_source)
+  {
+    restore_set_error(engine, error);
+    restore_finish(engine);
+
+    return;
+  }
+
+  OSSO_ABOOK_NOTE(GENERIC, "creating address book %s", book->uid);
+  e_source_set_parent(engine->new_source,
+                      book->parent ? book->parent : "local-stub");
+  e_source_set_display_name(engine->new_source,
+                            book->name ? book->name : book->uid);
+  backend = e_source_get_extension(engine->new_source,
+                                   E_SOURCE_EXTENSION_ADDRESS_BOOK);
+  e_source_backend_set_backend_name(backend, book->backend);
+
+  sources = g_list_append(NULL, engine->new_source);
+  e_source_registry_create_sources(engine->registry, sources,
+                                   engine->cancellable,
+                                   restore_create_source_cb, engine);
+  g_list_free(sources);
+}
+
+static void
+restore_next_book(restore_engine *engine)
+{
+  restore_book *book;
+  ESource *source;
+
+  if (engine->error || g_cancellable_is_cancelled(engine->cancellable) ||
+      engine->book == engine->books->len)
+  {
+    restore_finish(engine);
+
+    return;
+  }
+
+  book = restore_current_book(engine);
+
+  /* Writing to a roster book changes the contact list on the IM server, the
+   * roster fills again from there once its account connects */
+  if (book->uid && g_strcmp0(book->backend, "local"))
+  {
+    OSSO_ABOOK_NOTE(GENERIC, "leaving %d contacts of roster %s to its account",
+                    book->contacts->len, book->uid);
+    engine->skipped_books++;
+    engine->skipped_contacts += book->contacts->len;
+    engine->total_contacts -= book->contacts->len;
+    engine->book++;
+    restore_next_book(engine);
+
+    return;
+  }
+
+  if (book->uid)
+    source = e_source_registry_ref_source(engine->registry, book->uid);
+  else
+    source = e_source_registry_ref_builtin_address_book(engine->registry);
+
+  if (!source)
+  {
+    restore_create_source(engine, book);
+
+    return;
+  }
+
+  e_book_client_connect(source, 30, engine->cancellable, restore_connect_cb,
+                        engine);
+  g_object_unref(source);
+}
+
+static void
+restore_registry_cb(GObject *source_object, GAsyncResult *res,
+                    gpointer user_data)
+{
+  restore_engine *engine = user_data;
+  GError *error = NULL;
+
+  engine->registry = e_source_registry_new_finish(res, &error);
+
+  if (!engine->registry)
+  {
+    restore_set_error(engine, error);
+    restore_finish(engine);
+
+    return;
+  }
+
+  restore_next_book(engine);
+}
+
+static void
+restore_load_cb(GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  restore_engine *engine = user_data;
+  GError *error = NULL;
+  guint i;
+
+  engine->books = g_task_propagate_pointer(G_TASK(res), &error);
+
+  if (!engine->books)
+  {
+    restore_set_error(engine, error);
+    restore_finish(engine);
+
+    return;
+  }
+
+  for (i = 0; i < engine->books->len; i++)
+  {
+    restore_book *book = g_ptr_array_index(engine->books, i);
+
+    engine->total_contacts += book->contacts->len;
+  }
+
+  e_source_registry_new(engine->cancellable, restore_registry_cb, engine);
+}
+
+void
+restore_engine_start(restore_engine *engine)
+{
+  GTask *task;
+
+  g_return_if_fail(engine != NULL);
+
+  engine->start_time = g_get_monotonic_time();
+
+  /* nothing gets removed from the books unless the snapshot is fine */
+  task = g_task_new(NULL, engine->cancellable, restore_load_cb, engine);
+  g_task_set_task_data(task, engine, NULL);
+  g_task_run_in_thread(task, restore_load_thread);
+  g_object_unref(task);
+}
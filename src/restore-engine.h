@@ -0,0 +1,72 @@
+/*
+ * restore-engine.h
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef RESTORE_ENGINE_H
+#define RESTORE_ENGINE_H
+
+#include <gio/gio.h>
+
+typedef struct _restore_engine restore_engine;
+
+typedef struct
+{
+  /* in microseconds */
+  gint64 elapsed;
+  int books;
+  int total_contacts;
+  int restored_contacts;
+
+  /* roster books, those are not written to */
+  int skipped_books;
+  int skipped_contacts;
+} restore_stats;
+
+typedef void (*restore_engine_done_cb)(restore_engine *engine,
+                                       gpointer user_data);
+
+/* path is either a backup store, generation NULL picking the newest one, or a
+ * vCard file, which is restored to the system book. Every local book in the
+ * snapshot is emptied before its contacts are added back, local books that are
+ * gone are created again. Roster books are left to their accounts. */
+restore_engine *
+restore_engine_new(const gchar *path, const gchar *generation,
+                   restore_engine_done_cb cb, gpointer user_data);
+
+void
+restore_engine_free(restore_engine *engine);
+
+/* The whole snapshot is verified before any book is touched. cb gets called
+ * once every book is restored, the restore failed or got cancelled. */
+void
+restore_engine_start(restore_engine *engine);
+
+void
+restore_engine_cancel(restore_engine *engine);
+
+gdouble
+restore_engine_get_progress(restore_engine *engine);
+
+void
+restore_engine_get_stats(restore_engine *engine, restore_stats *stats);
+
+/* NULL if the restore succeeded */
+const GError *
+restore_engine_get_error(restore_engine *engine);
+
+#endif // RESTORE_ENGINE_H
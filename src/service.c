@@ -30,6 +30,8 @@
 #include "app.h"
 #include "menu.h"
 #include "actions.h"
+#include "backup-engine.h"
+#include "sim-export-engine.h"
 
 #include "service.h"
 
@@ -41,14 +43,28 @@ static GQuark can_add_shortcut_quark;
 static GQuark search_append_quark;
 static GQuark select_contacts_quark;
 static GQuark open_group_quark;
+static GQuark backup_quark;
+static GQuark copy_to_sim_quark;
 static GQuark response_quark;
 static GQuark release_quark;
 static GQuark osso_abook_object_owner_quark;
 static GQuark osso_abook_object_path_quark;
 
+static backup_engine *backup = NULL;
+static sim_export_engine *sim_export = NULL;
+
+/* a copy to SIM waiting for the SIM group to read the card */
+static gboolean sim_export_waiting = FALSE;
+
 void
 desktop_service_finalize()
-{}
+{
+  if (backup)
+    backup_engine_cancel(backup);
+
+  if (sim_export)
+    sim_export_engine_cancel(sim_export);
+}
 
 static const char *
 dbus_message_get_type_string(DBusMessage *message)
@@ -491,6 +507,168 @@ open_group(DBusMessage *message, osso_abook_data *data)
   return dbus_message_new_method_return(message);
 }
 
+static void
+backup_done_cb(backup_engine *engine, gpointer user_data)
+{
+  DBusMessage *message = user_data;
+  const GError *error = backup_engine_get_error(engine);
+  DBusMessage *reply;
+
+  if (error)
+  {
+    reply = dbus_message_new_error(message, DBUS_ERROR_FAILED,
+                                   error->message);
+  }
+  else
+    reply = dbus_message_new_method_return(message);
+
+  dbus_connection_send(
+    osso_get_dbus_connection(osso_abook_get_osso_context()), reply, NULL);
+  dbus_message_unref(reply);
+  dbus_message_unref(message);
+  backup_engine_free(engine);
+  backup = NULL;
+}
+
+/* Replies once the snapshot is written, EDS keeps running meanwhile */
+static DBusMessage *
+start_backup(DBusMessage *message)
+{
+  DBusError error;
+  const gchar *dir;
+
+  dbus_error_init(&error);
+
+  if (!dbus_message_get_args(message, &error,
+                             DBUS_TYPE_STRING, &dir,
+                             DBUS_TYPE_INVALID))
+  {
+    return dbus_message_new_error(message, error.name, error.message);
+  }
+
+  if (backup)
+  {
+    return dbus_message_new_error(message, DBUS_ERROR_LIMITS_EXCEEDED,
+                                  "Backup already in progress");
+  }
+
+  if (!g_path_is_absolute(dir))
+  {
+    return dbus_message_new_error(message, DBUS_ERROR_INVALID_ARGS,
+                                  "Backup directory must be absolute");
+  }
+
+  backup = backup_engine_new(dir, backup_done_cb, dbus_message_ref(message));
+  backup_engine_start(backup);
+
+  return NULL;
+}
+
+static void
+sim_export_done_cb(sim_export_engine *engine, gpointer user_data)
+{
+  DBusMessage *message = user_data;
+  const GError *error = sim_export_engine_get_error(engine);
+  DBusMessage *reply;
+
+  if (error)
+  {
+    reply = dbus_message_new_error(message, DBUS_ERROR_FAILED,
+                                   error->message);
+  }
+  else
+  {
+    sim_export_stats stats;
+
+    sim_export_engine_get_stats(engine, &stats);
+    reply = dbus_message_new_method_return(message);
+    dbus_message_append_args(reply,
+                             DBUS_TYPE_INT32, &stats.planned_entries,
+                             DBUS_TYPE_INT32, &stats.written_entries,
+                             DBUS_TYPE_INT32, &stats.free_entries,
+                             DBUS_TYPE_INT32, &stats.already_on_sim,
+                             DBUS_TYPE_INT32, &stats.overflow,
+                             DBUS_TYPE_INT32, &stats.truncated_names,
+                             DBUS_TYPE_INT32, &stats.dropped_emails,
+                             DBUS_TYPE_INT32, &stats.dropped_nicknames,
+                             DBUS_TYPE_INVALID);
+  }
+
+  dbus_connection_send(
+    osso_get_dbus_connection(osso_abook_get_osso_context()), reply, NULL);
+  dbus_message_unref(reply);
+  dbus_message_unref(message);
+  sim_export_engine_free(engine);
+  sim_export = NULL;
+}
+
+static void
+sim_group_ready_cb(OssoABookWaitable *waitable, const GError *error,
+                   gpointer user_data)
+{
+  DBusMessage *message = user_data;
+  dbus_bool_t dry_run = FALSE;
+  sim_export_limits limits;
+  DBusMessage *reply;
+
+  sim_export_waiting = FALSE;
+  dbus_message_get_args(message, NULL,
+                        DBUS_TYPE_BOOLEAN, &dry_run,
+                        DBUS_TYPE_INVALID);
+
+  if (!error &&
+      osso_abook_sim_group_get_limits(OSSO_ABOOK_SIM_GROUP(waitable),
+                                      &limits.max_entries,
+                                      &limits.max_sne_entries,
+                                      &limits.max_email_entries))
+  {
+    sim_export = sim_export_engine_new(&limits, dry_run, sim_export_done_cb,
+                                       dbus_message_ref(message));
+    sim_export_engine_start(sim_export);
+
+    return;
+  }
+
+  reply = dbus_message_new_error(message, DBUS_ERROR_FAILED,
+                                 "SIM card not ready");
+  dbus_connection_send(
+    osso_get_dbus_connection(osso_abook_get_osso_context()), reply, NULL);
+  dbus_message_unref(reply);
+}
+
+/* With dry_run the reply tells what would be written, nothing is. The reply
+ * is planned, written, free, already on the SIM, overflow, truncated names,
+ * dropped e-mails and dropped nicknames. It comes once the SIM group has read
+ * the card. */
+static DBusMessage *
+copy_to_sim(DBusMessage *message, osso_abook_data *data)
+{
+  DBusError error;
+  dbus_bool_t dry_run;
+
+  dbus_error_init(&error);
+
+  if (!dbus_message_get_args(message, &error,
+                             DBUS_TYPE_BOOLEAN, &dry_run,
+                             DBUS_TYPE_INVALID))
+  {
+    return dbus_message_new_error(message, error.name, error.message);
+  }
+
+  if (sim_export || sim_export_waiting)
+  {
+    return dbus_message_new_error(message, DBUS_ERROR_LIMITS_EXCEEDED,
+                                  "Copy to SIM already in progress");
+  }
+
+  sim_export_waiting = TRUE;
+  osso_abook_waitable_call_when_ready(
+    OSSO_ABOOK_WAITABLE(app_ensure_sim_group(data)), sim_group_ready_cb,
+    dbus_message_ref(message), (GDestroyNotify)&dbus_message_unref);
+
+  return NULL;
+}
+
 static DBusHandlerResult
 message_filter(DBusConnection *connection, DBusMessage *message,
                gpointer user_data)
@@ -557,6 +735,20 @@ message_filter(DBusConnection *connection, DBusMessage *message,
     reply = search_append(message, data);
   else if (member_quark == open_group_quark)
     reply = open_group(message, data);
+  else if (member_quark == backup_quark)
+  {
+    reply = start_backup(message);
+
+    if (!reply)
+      return DBUS_HANDLER_RESULT_HANDLED;
+  }
+  else if (member_quark == copy_to_sim_quark)
+  {
+    reply = copy_to_sim(message, data);
+
+    if (!reply)
+      return DBUS_HANDLER_RESULT_HANDLED;
+  }
   else
   {
     reply = dbus_message_new_error(message, DBUS_ERROR_UNKNOWN_METHOD,
@@ -597,6 +789,8 @@ desktop_service_init(osso_abook_data *data)
   search_append_quark = g_quark_from_static_string("search_append");
   select_contacts_quark = g_quark_from_static_string("select_contacts");
   open_group_quark = g_quark_from_static_string("open_group");
+  backup_quark = g_quark_from_static_string("backup");
+  copy_to_sim_quark = g_quark_from_static_string("copy_to_sim");
   response_quark = g_quark_from_static_string("Response");
   release_quark = g_quark_from_static_string("Release");
   osso_abook_object_owner_quark =
@@ -0,0 +1,195 @@
+/*
+ * sim-cache.c
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <glib/gstdio.h>
+
+#include <libosso-abook/osso-abook-log.h>
+
+#include "sim-cache.h"
+
+#define CAPABILITIES "capabilities"
+#define LIST "list"
+
+struct _sim_cache
+{
+  GKeyFile *keys;
+  gchar *imsi;
+};
+
+static gchar *
+cache_path(const gchar *name)
+{
+  return g_build_filename(g_get_home_dir(), ".osso-abook", "sim-cache", name,
+                          NULL);
+}
+
+/* the IMSI ends up as a file name */
+static gboolean
+is_imsi(const gchar *imsi)
+{
+  const gchar *p;
+
+  if (!imsi || !*imsi)
+    return FALSE;
+
+  for (p = imsi; *p; p++)
+  {
+    if (!g_ascii_isdigit(*p))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+sim_cache *
+sim_cache_new(void)
+{
+  sim_cache *cache = g_new0(sim_cache, 1);
+
+  cache->keys = g_key_file_new();
+
+  return cache;
+}
+
+sim_cache *
+sim_cache_load(const gchar *imsi)
+{
+  sim_cache *cache;
+  gchar *path;
+  GError *error = NULL;
+
+  if (!is_imsi(imsi))
+    return NULL;
+
+  cache = sim_cache_new();
+  path = cache_path(imsi);
+
+  if (!g_key_file_load_from_file(cache->keys, path, G_KEY_FILE_NONE, &error))
+  {
+    if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+      OSSO_ABOOK_WARN("Cannot load SIM cache %s: %s", path, error->message);
+
+    g_error_free(error);
+    sim_cache_free(cache);
+    cache = NULL;
+  }
+  else
+    cache->imsi = g_strdup(imsi);
+
+  g_free(path);
+
+  return cache;
+}
+
+void
+sim_cache_free(sim_cache *cache)
+{
+  if (!cache)
+    return;
+
+  g_key_file_free(cache->keys);
+  g_free(cache->imsi);
+  g_free(cache);
+}
+
+const gchar *
+sim_cache_get_imsi(sim_cache *cache)
+{
+  g_return_val_if_fail(cache != NULL, NULL);
+
+  return cache->imsi;
+}
+
+void
+sim_cache_set_imsi(sim_cache *cache, const gchar *imsi)
+{
+  g_return_if_fail(cache != NULL);
+
+  g_free(cache->imsi);
+  cache->imsi = g_strdup(imsi);
+}
+
+int
+sim_cache_get_capability(sim_cache *cache, const gchar *name)
+{
+  g_return_val_if_fail(cache != NULL, 0);
+
+  return g_key_file_get_integer(cache->keys, CAPABILITIES, name, NULL);
+}
+
+void
+sim_cache_set_capability(sim_cache *cache, const gchar *name, int value)
+{
+  g_return_if_fail(cache != NULL);
+
+  g_key_file_set_integer(cache->keys, CAPABILITIES, name, value);
+}
+
+gchar **
+sim_cache_get_list(sim_cache *cache, const gchar *book)
+{
+  g_return_val_if_fail(cache != NULL, NULL);
+
+  if (!g_key_file_has_key(cache->keys, book, LIST, NULL))
+    return NULL;
+
+  return g_key_file_get_string_list(cache->keys, book, LIST, NULL, NULL);
+}
+
+void
+sim_cache_set_list(sim_cache *cache, const gchar *book,
+                   const gchar * const *list)
+{
+  g_return_if_fail(cache != NULL);
+
+  g_key_file_set_string_list(cache->keys, book, LIST, list,
+                             g_strv_length((gchar **)list));
+}
+
+gboolean
+sim_cache_save(sim_cache *cache, GError **error)
+{
+  gchar *path;
+  gchar *dir;
+  gchar *data;
+  gsize len;
+  gboolean rv;
+
+  g_return_val_if_fail(cache != NULL, FALSE);
+
+  if (!is_imsi(cache->imsi))
+  {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Invalid IMSI %s",
+                cache->imsi ? cache->imsi : "(null)");
+
+    return FALSE;
+  }
+
+  path = cache_path(cache->imsi);
+  dir = g_path_get_dirname(path);
+  g_mkdir_with_parents(dir, 0700);
+  g_free(dir);
+
+  data = g_key_file_to_data(cache->keys, &len, NULL);
+  rv = g_file_set_contents(path, data, len, error);
+  g_free(data);
+  g_free(path);
+
+  return rv;
+}
@@ -0,0 +1,65 @@
+/*
+ * sim-cache.h
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SIM_CACHE_H
+#define SIM_CACHE_H
+
+#include <glib.h>
+
+/* What was read from a SIM card, kept per IMSI so the SIM group can be
+ * populated before the card is. Lists are stored per book, as vCards for the
+ * phonebooks and as numbers for the voicemail box. */
+typedef struct _sim_cache sim_cache;
+
+sim_cache *
+sim_cache_new(void);
+
+/* The cache of the card with that IMSI, NULL if there is none */
+sim_cache *
+sim_cache_load(const gchar *imsi);
+
+void
+sim_cache_free(sim_cache *cache);
+
+/* NULL until the card got read */
+const gchar *
+sim_cache_get_imsi(sim_cache *cache);
+
+void
+sim_cache_set_imsi(sim_cache *cache, const gchar *imsi);
+
+int
+sim_cache_get_capability(sim_cache *cache, const gchar *name);
+
+void
+sim_cache_set_capability(sim_cache *cache, const gchar *name, int value);
+
+/* NULL terminated, NULL if the book was not cached */
+gchar **
+sim_cache_get_list(sim_cache *cache, const gchar *book);
+
+void
+sim_cache_set_list(sim_cache *cache, const gchar *book,
+                   const gchar * const *list);
+
+/* Saves the cache under its IMSI */
+gboolean
+sim_cache_save(sim_cache *cache, GError **error);
+
+#endif // SIM_CACHE_H
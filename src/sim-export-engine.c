@@ -0,0 +1,584 @@
+/*
+ * sim-export-engine.c
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <libebook/libebook.h>
+#include <libosso-abook/osso-abook-log.h>
+
+#include "contact-index.h"
+#include "osso-abook-sim-group.h"
+
+#include "sim-export-engine.h"
+
+/* every add goes to the modem, a batch still is a single request to EDS */
+#define ENTRIES_PER_BATCH 20
+
+/* The card does not tell how long a name can be, 14 bytes fit on about every
+ * one of them */
+#define SIM_NAME_LENGTH 14
+
+/* GSM 03.38 default alphabet, a byte per character on the card */
+static const char gsm_alphabet[] =
+  "@£$¥èéùìòÇ\nØø\rÅåΔ_ΦΓΛΩΠΨΣΘΞÆæßÉ !\"#¤%&'()*+,-./0123456789:;<=>?"
+  "¡ABCDEFGHIJKLMNOPQRSTUVWXYZÄÖÑÜ§¿abcdefghijklmnopqrstuvwxyzäöñüà";
+
+/* its extension table, an escape byte more */
+static const char gsm_extension[] = "^{}\\[~]|€";
+
+struct _sim_export_engine
+{
+  sim_export_limits limits;
+  gboolean dry_run;
+  GCancellable *cancellable;
+  sim_export_engine_done_cb cb;
+  gpointer user_data;
+  GError *error;
+
+  ESourceRegistry *registry;
+  EBookClient *client;
+  GSList *contacts;
+
+  /* EContact, the write set */
+  GPtrArray *entries;
+  guint next_entry;
+  guint batch_len;
+
+  gint64 start_time;
+  gint64 end_time;
+  sim_export_stats stats;
+};
+
+sim_export_engine *
+sim_export_engine_new(const sim_export_limits *limits, gboolean dry_run,
+                      sim_export_engine_done_cb cb, gpointer user_data)
+{
+  sim_export_engine *engine;
+
+  g_return_val_if_fail(limits != NULL, NULL);
+
+  engine = g_new0(sim_export_engine, 1);
+  engine->limits = *limits;
+  engine->dry_run = dry_run;
+  engine->cb = cb;
+  engine->user_data = user_data;
+  engine->cancellable = g_cancellable_new();
+  engine->entries = g_ptr_array_new_with_free_func(g_object_unref);
+
+  return engine;
+}
+
+void
+sim_export_engine_free(sim_export_engine *engine)
+{
+  if (!engine)
+    return;
+
+  g_slist_free_full(engine->contacts, g_object_unref);
+  g_ptr_array_free(engine->entries, TRUE);
+
+  if (engine->client)
+    g_object_unref(engine->client);
+
+  if (engine->registry)
+    g_object_unref(engine->registry);
+
+  g_clear_error(&engine->error);
+  g_object_unref(engine->cancellable);
+  g_free(engine);
+}
+
+void
+sim_export_engine_cancel(sim_export_engine *engine)
+{
+  g_return_if_fail(engine != NULL);
+
+  g_cancellable_cancel(engine->cancellable);
+}
+
+gdouble
+sim_export_engine_get_progress(sim_export_engine *engine)
+{
+  g_return_val_if_fail(engine != NULL, 0.0);
+
+  if (!engine->stats.planned_entries)
+    return 0.0;
+
+  return (gdouble)engine->stats.written_entries /
+      engine->stats.planned_entries;
+}
+
+void
+sim_export_engine_get_stats(sim_export_engine *engine,
+                            sim_export_stats *stats)
+{
+  g_return_if_fail(engine != NULL);
+  g_return_if_fail(stats != NULL);
+
+  *stats = engine->stats;
+  stats->elapsed = (engine->end_time ? engine->end_time :
+                    g_get_monotonic_time()) - engine->start_time;
+}
+
+const GError *
+sim_export_engine_get_error(sim_export_engine *engine)
+{
+  g_return_val_if_fail(engine != NULL, NULL);
+
+  return engine->error;
+}
+
+static void
+sim_export_set_error(sim_export_engine *engine, GError *error)
+{
+  if (!engine->error)
+    engine->error = error;
+  else
+    g_error_free(error);
+}
+
+static gboolean
+sim_export_done_cb(gpointer user_data)
+{
+  sim_export_engine *engine = user_data;
+
+  if (engine->cb)
+    engine->cb(engine, engine->user_data);
+
+  return FALSE;
+}
+
+static void
+sim_export_finish(sim_export_engine *engine)
+{
+  if (!engine->error && g_cancellable_is_cancelled(engine->cancellable))
+  {
+    g_set_error_literal(&engine->error, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                        "SIM export cancelled");
+  }
+
+  engine->end_time = g_get_monotonic_time();
+
+  if (engine->error)
+    OSSO_ABOOK_WARN("SIM export failed: %s", engine->error->message);
+  else
+  {
+    OSSO_ABOOK_NOTE(GENERIC, "%s %d of %d SIM entries in %.2f s",
+                    engine->dry_run ? "planned" : "wrote",
+                    engine->stats.written_entries,
+                    engine->stats.planned_entries,
+                    (engine->end_time - engine->start_time) /
+                    (gdouble)G_USEC_PER_SEC);
+  }
+
+  g_idle_add(sim_export_done_cb, engine);
+}
+
+/* The mobile number if there is one, the first number otherwise */
+static const char *
+pick_number(EContact *contact)
+{
+  const char *number = NULL;
+  GList *l;
+
+  for (l = e_vcard_get_attributes(E_VCARD(contact)); l; l = l->next)
+  {
+    EVCardAttribute *attr = l->data;
+    GList *values;
+
+    if (g_ascii_strcasecmp(e_vcard_attribute_get_name(attr), EVC_TEL))
+      continue;
+
+    values = e_vcard_attribute_get_values(attr);
+
+    if (!values || !values->data || !*(const char *)values->data)
+      continue;
+
+    if (e_vcard_attribute_has_type(attr, "CELL"))
+      return values->data;
+
+    if (!number)
+      number = values->data;
+  }
+
+  return number;
+}
+
+static gboolean
+has_room(int *used, int max)
+{
+  if (*used >= max)
+    return FALSE;
+
+  (*used)++;
+
+  return TRUE;
+}
+
+/* How many characters of name fit in SIM_NAME_LENGTH bytes. A name with a
+ * character out of the GSM alphabet is stored as UCS-2, two bytes per
+ * character after a byte telling the coding. */
+static glong
+sim_name_fit(const char *name)
+{
+  const char *p;
+  glong chars = 0;
+  int bytes = 0;
+
+  for (p = name; *p; p = g_utf8_next_char(p))
+  {
+    gunichar c = g_utf8_get_char(p);
+    int size;
+
+    if (g_utf8_strchr(gsm_alphabet, -1, c))
+      size = 1;
+    else if (g_utf8_strchr(gsm_extension, -1, c))
+      size = 2;
+    else
+      return MIN(g_utf8_strlen(name, -1), (SIM_NAME_LENGTH - 1) / 2);
+
+    /* what is left of the name is cut, whatever its coding */
+    if (bytes + size > SIM_NAME_LENGTH)
+      break;
+
+    bytes += size;
+    chars++;
+  }
+
+  return chars;
+}
+
+static EContact *
+sim_entry_new(sim_export_engine *engine, EContact *contact,
+              const char *number, int *emails, int *nicknames)
+{
+  EContact *entry = e_contact_new();
+  const char *name = e_contact_get_const(contact, E_CONTACT_FULL_NAME);
+  const char *email = e_contact_get_const(contact, E_CONTACT_EMAIL_1);
+  const char *nickname = e_contact_get_const(contact, E_CONTACT_NICKNAME);
+  glong fit;
+
+  if (!name || !*name)
+    name = number;
+
+  fit = sim_name_fit(name);
+
+  if (fit < g_utf8_strlen(name, -1))
+  {
+    gchar *truncated = g_utf8_substring(name, 0, fit);
+
+    e_contact_set(entry, E_CONTACT_FULL_NAME, truncated);
+    g_free(truncated);
+    engine->stats.truncated_names++;
+  }
+  else
+    e_contact_set(entry, E_CONTACT_FULL_NAME, name);
+
+  e_vcard_add_attribute_with_value(E_VCARD(entry),
+                                   e_vcard_attribute_new(NULL, EVC_TEL),
+                                   number);
+
+  if (email && *email)
+  {
+    if (has_room(emails, engine->limits.max_email_entries))
+      e_contact_set(entry, E_CONTACT_EMAIL_1, email);
+    else
+      engine->stats.dropped_emails++;
+  }
+
+  if (nickname && *nickname)
+  {
+    if (has_room(nicknames, engine->limits.max_sne_entries))
+      e_contact_set(entry, E_CONTACT_NICKNAME, nickname);
+    else
+      engine->stats.dropped_nicknames++;
+  }
+
+  return entry;
+}
+
+/* Numbers on the card already are not written again, and what does not fit
+ * is counted as overflow instead of failing halfway through the write */
+static void
+sim_export_plan(sim_export_engine *engine, GSList *sim_contacts)
+{
+  GHashTable *numbers = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                              g_free, NULL);
+  int emails = 0;
+  int nicknames = 0;
+  GSList *l;
+
+  for (l = sim_contacts; l; l = l->next)
+  {
+    const char *number = pick_number(l->data);
+
+    if (number)
+      g_hash_table_add(numbers, contact_index_normalize_phone(number));
+
+    if (e_contact_get_const(l->data, E_CONTACT_EMAIL_1))
+      emails++;
+
+    if (e_contact_get_const(l->data, E_CONTACT_NICKNAME))
+      nicknames++;
+  }
+
+  engine->stats.free_entries =
+      MAX(engine->limits.max_entries - (int)g_slist_length(sim_contacts), 0);
+
+  for (l = engine->contacts; l; l = l->next)
+  {
+    const char *number = pick_number(l->data);
+    gchar *normalized;
+
+    if (!number)
+      continue;
+
+    engine->stats.contacts++;
+    normalized = contact_index_normalize_phone(number);
+
+    if (g_hash_table_contains(numbers, normalized))
+    {
+      engine->stats.already_on_sim++;
+      g_free(normalized);
+    }
+    else if ((int)engine->entries->len == engine->stats.free_entries)
+    {
+      engine->stats.overflow++;
+      g_free(normalized);
+    }
+    else
+    {
+      g_hash_table_add(numbers, normalized);
+      g_ptr_array_add(engine->entries,
+                      sim_entry_new(engine, l->data, number, &emails,
+                                    &nicknames));
+    }
+  }
+
+  g_hash_table_destroy(numbers);
+  engine->stats.planned_entries = engine->entries->len;
+
+  OSSO_ABOOK_NOTE(GENERIC,
+                  "SIM export plan: %d entries, %d free, %d on the SIM "
+                  "already, %d overflow, %d names truncated",
+                  engine->stats.planned_entries, engine->stats.free_entries,
+                  engine->stats.already_on_sim, engine->stats.overflow,
+                  engine->stats.truncated_names);
+}
+
+static void
+sim_export_commit_batch(sim_export_engine *engine);
+
+static void
+sim_export_add_contacts_cb(GObject *source_object, GAsyncResult *res,
+                           gpointer user_data)
+{
+  sim_export_engine *engine = user_data;
+  GError *error = NULL;
+
+  if (!e_book_client_add_contacts_finish(E_BOOK_CLIENT(source_object), res,
+                                         NULL, &error))
+  {
+    sim_export_set_error(engine, error);
+    sim_export_finish(engine);
+
+    return;
+  }
+
+  engine->stats.written_entries += engine->batch_len;
+  sim_export_commit_batch(engine);
+}
+
+static void
+sim_export_commit_batch(sim_export_engine *engine)
+{
+  GSList *batch = NULL;
+  guint i;
+
+  if (engine->next_entry == engine->entries->len)
+  {
+    sim_export_finish(engine);
+
+    return;
+  }
+
+  for (i = MIN(engine->next_entry + ENTRIES_PER_BATCH, engine->entries->len);
+       i > engine->next_entry; i--)
+  {
+    batch = g_slist_prepend(batch, g_ptr_array_index(engine->entries, i - 1));
+  }
+
+  engine->batch_len = g_slist_length(batch);
+  engine->next_entry += engine->batch_len;
+
+  e_book_client_add_contacts(engine->client, batch, E_BOOK_OPERATION_FLAG_NONE,
+                             engine->cancellable, sim_export_add_contacts_cb,
+                             engine);
+  g_slist_free(batch);
+}
+
+static void
+sim_export_sim_contacts_cb(GObject *source_object, GAsyncResult *res,
+                           gpointer user_data)
+{
+  sim_export_engine *engine = user_data;
+  GSList *sim_contacts = NULL;
+  GError *error = NULL;
+
+  if (!e_book_client_get_contacts_finish(E_BOOK_CLIENT(source_object), res,
+                                         &sim_contacts, &error))
+  {
+    sim_export_set_error(engine, error);
+    sim_export_finish(engine);
+
+    return;
+  }
+
+  sim_export_plan(engine, sim_contacts);
+  g_slist_free_full(sim_contacts, g_object_unref);
+
+  if (engine->dry_run)
+    sim_export_finish(engine);
+  else
+    sim_export_commit_batch(engine);
+}
+
+static void
+get_contacts(sim_export_engine *engine, EBookQuery *query,
+             GAsyncReadyCallback cb)
+{
+  gchar *sexp = e_book_query_to_string(query);
+
+  e_book_client_get_contacts(engine->client, sexp, engine->cancellable, cb,
+                             engine);
+  g_free(sexp);
+  e_book_query_unref(query);
+}
+
+static void
+sim_export_sim_connect_cb(GObject *source_object, GAsyncResult *res,
+                          gpointer user_data)
+{
+  sim_export_engine *engine = user_data;
+  GError *error = NULL;
+  EClient *client = e_book_client_connect_finish(res, &error);
+
+  if (!client)
+  {
+    sim_export_set_error(engine, error);
+    sim_export_finish(engine);
+
+    return;
+  }
+
+  g_object_unref(engine->client);
+  engine->client = E_BOOK_CLIENT(client);
+  get_contacts(engine, e_book_query_any_field_contains(""),
+               sim_export_sim_contacts_cb);
+}
+
+static void
+sim_export_contacts_cb(GObject *source_object, GAsyncResult *res,
+                       gpointer user_data)
+{
+  sim_export_engine *engine = user_data;
+  GError *error = NULL;
+  ESource *source;
+  gchar *uid;
+
+  if (!e_book_client_get_contacts_finish(E_BOOK_CLIENT(source_object), res,
+                                         &engine->contacts, &error))
+  {
+    sim_export_set_error(engine, error);
+    sim_export_finish(engine);
+
+    return;
+  }
+
+  /* created by the SIM group, named after the book */
+  uid = g_strconcat(g_getenv("OSSO_ABOOK_FAKE_SIM") ?
+                    OSSO_ABOOK_FAKE_SIM_UID_PREFIX : "", "adn", NULL);
+  source = e_source_registry_ref_source(engine->registry, uid);
+  g_free(uid);
+
+  if (!source)
+  {
+    g_set_error_literal(&engine->error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                        "No SIM address book");
+    sim_export_finish(engine);
+
+    return;
+  }
+
+  e_book_client_connect(source, 30, engine->cancellable,
+                        sim_export_sim_connect_cb, engine);
+  g_object_unref(source);
+}
+
+static void
+sim_export_connect_cb(GObject *source_object, GAsyncResult *res,
+                      gpointer user_data)
+{
+  sim_export_engine *engine = user_data;
+  GError *error = NULL;
+  EClient *client = e_book_client_connect_finish(res, &error);
+
+  if (!client)
+  {
+    sim_export_set_error(engine, error);
+    sim_export_finish(engine);
+
+    return;
+  }
+
+  engine->client = E_BOOK_CLIENT(client);
+  get_contacts(engine, e_book_query_field_exists(E_CONTACT_TEL),
+               sim_export_contacts_cb);
+}
+
+static void
+sim_export_registry_cb(GObject *source_object, GAsyncResult *res,
+                       gpointer user_data)
+{
+  sim_export_engine *engine = user_data;
+  GError *error = NULL;
+  ESource *source;
+
+  engine->registry = e_source_registry_new_finish(res, &error);
+
+  if (!engine->registry)
+  {
+    sim_export_set_error(engine, error);
+    sim_export_finish(engine);
+
+    return;
+  }
+
+  source = e_source_registry_ref_builtin_address_book(engine->registry);
+  e_book_client_connect(source, 30, engine->cancellable, sim_export_connect_cb,
+                        engine);
+  g_object_unref(source);
+}
+
+void
+sim_export_engine_start(sim_export_engine *engine)
+{
+  g_return_if_fail(engine != NULL);
+
+  engine->start_time = g_get_monotonic_time();
+  e_source_registry_new(engine->cancellable, sim_export_registry_cb, engine);
+}
@@ -0,0 +1,86 @@
+/*
+ * sim-export-engine.h
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SIM_EXPORT_ENGINE_H
+#define SIM_EXPORT_ENGINE_H
+
+#include <gio/gio.h>
+
+/* What the card can hold, as the static capabilities of the SIM books say */
+typedef struct
+{
+  int max_entries;
+  int max_sne_entries;
+  int max_email_entries;
+} sim_export_limits;
+
+typedef struct _sim_export_engine sim_export_engine;
+
+typedef struct
+{
+  /* in microseconds */
+  gint64 elapsed;
+  /* contacts with a phone number */
+  int contacts;
+  /* ADN entries the card has room for */
+  int free_entries;
+  int planned_entries;
+  int written_entries;
+  /* left out, their number is on the card already */
+  int already_on_sim;
+  /* left out, the card is full */
+  int overflow;
+  int truncated_names;
+  int dropped_emails;
+  int dropped_nicknames;
+} sim_export_stats;
+
+typedef void (*sim_export_engine_done_cb)(sim_export_engine *engine,
+                                          gpointer user_data);
+
+/* Copies the contacts of the system book to the ADN book of the SIM, an entry
+ * per contact with the mobile number preferred. The whole write set is
+ * planned within limits before anything gets written. */
+sim_export_engine *
+sim_export_engine_new(const sim_export_limits *limits, gboolean dry_run,
+                      sim_export_engine_done_cb cb, gpointer user_data);
+
+void
+sim_export_engine_free(sim_export_engine *engine);
+
+/* cb gets called once the entries are written, or planned only for a dry
+ * run, the export failed or got cancelled */
+void
+sim_export_engine_start(sim_export_engine *engine);
+
+void
+sim_export_engine_cancel(sim_export_engine *engine);
+
+gdouble
+sim_export_engine_get_progress(sim_export_engine *engine);
+
+void
+sim_export_engine_get_stats(sim_export_engine *engine,
+                            sim_export_stats *stats);
+
+/* NULL if the export succeeded */
+const GError *
+sim_export_engine_get_error(sim_export_engine *engine);
+
+#endif // SIM_EXPORT_ENGINE_H
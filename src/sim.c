@@ -19,25 +19,354 @@
 
 #include "config.h"
 
+#include <hildon/hildon.h>
+
+#include <libebook/libebook.h>
+#include <libosso-abook/osso-abook-contact-view.h>
+#include <libosso-abook/osso-abook-log.h>
 #include <libosso-abook/osso-abook-util.h>
 
+#include <libintl.h>
+
+#include "actions.h"
 #include "app.h"
+#include "contact-index.h"
 #include "sim.h"
 
+/* a SIM holds a few hundred contacts at most, the progress bar still moves */
+#define SIM_IMPORT_BATCH_SIZE 50
+
+typedef struct
+{
+  GtkWidget *parent;
+  GtkWidget *note;
+  GtkWidget *progress_bar;
+  GCancellable *cancellable;
+  EBookClient *client;
+
+  /* EContact, in SIM order */
+  GList *contacts;
+  GList *next;
+  int total;
+  int processed;
+  int committing;
+  int imported;
+  GError *error;
+} sim_import_data;
+
+static void
+sim_import_finish(sim_import_data *sid)
+{
+  if (sid->note)
+    gtk_widget_destroy(sid->note);
+
+  if (sid->error)
+  {
+    if (!g_error_matches(sid->error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      OSSO_ABOOK_WARN("SIM import failed: %s", sid->error->message);
+      hildon_banner_show_information(
+        sid->parent, NULL, dgettext(NULL, "addr_ni_importing_fail"));
+    }
+
+    g_error_free(sid->error);
+  }
+  else
+  {
+    hildon_banner_show_information(
+      sid->parent, NULL, dgettext(NULL, "addr_ib_imported_successfully"));
+  }
+
+  OSSO_ABOOK_NOTE(EDS, "imported %d of %d SIM contacts", sid->imported,
+                  sid->total);
+
+  if (sid->client)
+    g_object_unref(sid->client);
+
+  g_list_free_full(sid->contacts, g_object_unref);
+  g_object_unref(sid->cancellable);
+  g_object_unref(sid->parent);
+  g_free(sid);
+}
+
+static void
+sim_import_response_cb(GtkWidget *note, gint response_id,
+                       sim_import_data *sid)
+{
+  /* whatever is committed already stays */
+  g_cancellable_cancel(sid->cancellable);
+  gtk_widget_destroy(sid->note);
+  sid->note = NULL;
+  sid->progress_bar = NULL;
+}
+
+static void
+sim_import_update_progress(sim_import_data *sid)
+{
+  gchar *text;
+
+  if (!sid->progress_bar)
+    return;
+
+  text = g_strdup_printf("%d/%d", sid->processed, sid->total);
+  gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(sid->progress_bar),
+                                sid->total ?
+                                  (gdouble)sid->processed / sid->total : 1.0);
+  gtk_progress_bar_set_text(GTK_PROGRESS_BAR(sid->progress_bar), text);
+  g_free(text);
+}
+
+static void
+sim_import_next_batch(sim_import_data *sid);
+
+static void
+sim_import_add_contacts_cb(GObject *source_object, GAsyncResult *res,
+                           gpointer user_data)
+{
+  sim_import_data *sid = user_data;
+
+  if (!e_book_client_add_contacts_finish(E_BOOK_CLIENT(source_object), res,
+                                         NULL, &sid->error))
+  {
+    sim_import_finish(sid);
+  }
+  else
+  {
+    sid->imported += sid->committing;
+    sim_import_next_batch(sid);
+  }
+}
+
+static void
+sim_import_next_batch(sim_import_data *sid)
+{
+  GSList *batch = NULL;
+  int n = 0;
+
+  sim_import_update_progress(sid);
+
+  while (sid->next && n < SIM_IMPORT_BATCH_SIZE)
+  {
+    if (sid->next->data)
+    {
+      batch = g_slist_prepend(batch, sid->next->data);
+      n++;
+    }
+
+    sid->processed++;
+    sid->next = sid->next->next;
+  }
+
+  if (!batch)
+  {
+    sim_import_finish(sid);
+
+    return;
+  }
+
+  sid->committing = n;
+  batch = g_slist_reverse(batch);
+  e_book_client_add_contacts(sid->client, batch, E_BOOK_OPERATION_FLAG_NONE,
+                             sid->cancellable, sim_import_add_contacts_cb,
+                             sid);
+  g_slist_free(batch);
+}
+
+static void
+add_numbers(GHashTable *numbers, EContact *contact)
+{
+  GList *tel = e_contact_get(contact, E_CONTACT_TEL);
+  GList *l;
+
+  for (l = tel; l; l = l->next)
+  {
+    gchar *number = contact_index_normalize_phone(l->data);
+
+    if (*number)
+      g_hash_table_add(numbers, number);
+    else
+      g_free(number);
+  }
+
+  g_list_free_full(tel, g_free);
+}
+
+static gboolean
+has_known_number(GHashTable *numbers, EContact *contact)
+{
+  GList *tel = e_contact_get(contact, E_CONTACT_TEL);
+  GList *l;
+  gboolean rv = FALSE;
+
+  for (l = tel; l && !rv; l = l->next)
+  {
+    gchar *number = contact_index_normalize_phone(l->data);
+
+    rv = g_hash_table_contains(numbers, number);
+    g_free(number);
+  }
+
+  g_list_free_full(tel, g_free);
+
+  return rv;
+}
+
+/* Contacts with a number the book has already are dropped, their slot in the
+ * list is kept so the progress counts every SIM contact */
+static void
+sim_import_get_contacts_cb(GObject *source_object, GAsyncResult *res,
+                           gpointer user_data)
+{
+  sim_import_data *sid = user_data;
+  GSList *existing = NULL;
+  GHashTable *numbers;
+  GSList *c;
+  GList *l;
+
+  if (!e_book_client_get_contacts_finish(E_BOOK_CLIENT(source_object), res,
+                                         &existing, &sid->error))
+  {
+    sim_import_finish(sid);
+
+    return;
+  }
+
+  numbers = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+  for (c = existing; c; c = c->next)
+    add_numbers(numbers, c->data);
+
+  g_slist_free_full(existing, g_object_unref);
+
+  for (l = sid->contacts; l; l = l->next)
+  {
+    if (has_known_number(numbers, l->data))
+    {
+      g_object_unref(l->data);
+      l->data = NULL;
+    }
+    else
+      add_numbers(numbers, l->data);
+  }
+
+  g_hash_table_destroy(numbers);
+
+  sid->next = sid->contacts;
+  sim_import_next_batch(sid);
+}
+
+static void
+sim_import_connect_cb(GObject *source_object, GAsyncResult *res,
+                      gpointer user_data)
+{
+  sim_import_data *sid = user_data;
+  EClient *client = e_book_client_connect_finish(res, &sid->error);
+  EBookQuery *query;
+  gchar *sexp;
+
+  if (!client)
+  {
+    sim_import_finish(sid);
+
+    return;
+  }
+
+  sid->client = E_BOOK_CLIENT(client);
+  query = e_book_query_field_exists(E_CONTACT_TEL);
+  sexp = e_book_query_to_string(query);
+  e_book_client_get_contacts(sid->client, sexp, sid->cancellable,
+                             sim_import_get_contacts_cb, sid);
+  g_free(sexp);
+  e_book_query_unref(query);
+}
+
+/* A copy the system book assigns a new UID to */
+static EContact *
+sim_contact_copy(EContact *simcontact)
+{
+  EContact *contact = e_contact_duplicate(simcontact);
+
+  e_contact_set(contact, E_CONTACT_UID, NULL);
+
+  return contact;
+}
+
 void
 sim_import_all(GtkWidget *parent, OssoABookSimGroup *sim_group, GtkWidget *note,
                GtkWidget *progress_bar)
 
 {
-  /* implement me */
-  g_assert(0);
+  sim_import_data *sid;
+  GList *contacts;
+  GList *l;
+  EBook *book;
+  GError *error = NULL;
+
+  g_return_if_fail(OSSO_ABOOK_IS_SIM_GROUP(sim_group));
+
+  book = osso_abook_system_book_dup_singleton(FALSE, &error);
+
+  if (!book)
+  {
+    OSSO_ABOOK_WARN("cannot get system book [%s]", error->message);
+    g_error_free(error);
+
+    if (note)
+      gtk_widget_destroy(note);
+
+    return;
+  }
+
+  sid = g_new0(sim_import_data, 1);
+  sid->parent = g_object_ref(parent);
+  sid->cancellable = g_cancellable_new();
+
+  contacts = osso_abook_sim_group_list_adn_contacts(sim_group);
+
+  for (l = contacts; l; l = l->next)
+    sid->contacts = g_list_prepend(sid->contacts, sim_contact_copy(l->data));
+
+  g_list_free(contacts);
+  sid->contacts = g_list_reverse(sid->contacts);
+  sid->total = g_list_length(sid->contacts);
+
+  if (!note)
+  {
+    progress_bar = gtk_progress_bar_new();
+    note = hildon_note_new_cancel_with_progress_bar(
+        GTK_WINDOW(parent), dgettext(NULL, "addr_pb_notification13"),
+        GTK_PROGRESS_BAR(progress_bar));
+    gtk_widget_show(note);
+  }
+
+  sid->note = note;
+  sid->progress_bar = progress_bar;
+  g_signal_connect(note, "response", G_CALLBACK(sim_import_response_cb), sid);
+  sim_import_update_progress(sid);
+
+  e_book_client_connect(e_book_get_source(book), 30, sid->cancellable,
+                        sim_import_connect_cb, sid);
+  g_object_unref(book);
+}
+
+static void
+import_contact_cb(EBook *book, const GError *error, const gchar *id,
+                  gpointer closure)
+{
+  if (error)
+    OSSO_ABOOK_WARN("Cannot import SIM contact: %s", error->message);
+  else
+    OSSO_ABOOK_NOTE(EDS, "SIM contact imported as %s", id);
+
+  g_object_unref(closure);
 }
 
 static void
 _import_contact(EBook *book, EContact *simcontact)
 {
-  /* implement me */
-  g_assert(0);
+  EContact *contact = sim_contact_copy(simcontact);
+
+  e_book_add_contact_async(book, contact, import_contact_cb, contact);
 }
 
 void
@@ -48,13 +377,68 @@ sim_import_contact(OssoABookContact *contact)
   g_return_if_fail(OSSO_ABOOK_IS_CONTACT(contact));
 
   book = osso_abook_system_book_dup_singleton(FALSE, NULL);
-  _import_contact(book, E_CONTACT(contact));
-  g_object_unref(book);
+
+  if (book)
+  {
+    _import_contact(book, E_CONTACT(contact));
+    g_object_unref(book);
+  }
 }
 
+static void
+sim_view_window_hide_cb(GtkWidget *window, gpointer user_data)
+{
+  gtk_widget_destroy(window);
+}
+
+static void
+sim_contact_activated_cb(OssoABookContactView *view,
+                         OssoABookContact *master_contact,
+                         osso_abook_data *data)
+{
+  create_menu(data, sim_bt_menu_actions, G_N_ELEMENTS(sim_bt_menu_actions),
+              master_contact);
+}
+
+/* The view uses the model of the SIM group, which merges what is read from
+ * the card in batches, nothing gets copied when the window opens */
 void
 open_sim_view_window(osso_abook_data *data, OssoABookGroup *group)
 {
-  /* implement me */
-  g_assert(0);
+  OssoABookListStore *model;
+  OssoABookFilterModel *filter_model;
+  GtkWidget *contact_view;
+  GtkWidget *window;
+  GtkWidget *align;
+
+  g_return_if_fail(data);
+  g_return_if_fail(OSSO_ABOOK_IS_SIM_GROUP(group));
+
+  window = hildon_stackable_window_new();
+  gtk_window_set_title(GTK_WINDOW(window),
+                       dgettext(NULL, osso_abook_group_get_name(group)));
+  g_signal_connect(window, "hide",
+                   G_CALLBACK(sim_view_window_hide_cb), NULL);
+
+  model = osso_abook_group_get_model(group);
+  filter_model = osso_abook_filter_model_new(model);
+  contact_view = osso_abook_contact_view_new(HILDON_UI_MODE_NORMAL,
+                                             OSSO_ABOOK_CONTACT_MODEL(model),
+                                             filter_model);
+  g_object_unref(filter_model);
+  g_signal_connect(contact_view, "contact-activated",
+                   G_CALLBACK(sim_contact_activated_cb), data);
+
+  _setup_live_search(HILDON_WINDOW(window),
+                     OSSO_ABOOK_TREE_VIEW(contact_view));
+
+  align = gtk_alignment_new(0.0, 0.0, 1.0, 1.0);
+  gtk_alignment_set_padding(GTK_ALIGNMENT(align), 4, 0, 16, 16);
+  gtk_container_add(GTK_CONTAINER(align), contact_view);
+  gtk_container_add(GTK_CONTAINER(window), align);
+
+  if (data->live_search)
+    gtk_widget_hide(data->live_search);
+
+  gtk_widget_show_all(window);
 }
@@ -0,0 +1,147 @@
+/*
+ * trace.c
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <libosso-abook/osso-abook-log.h>
+
+#include <unistd.h>
+
+#include "trace.h"
+
+typedef struct
+{
+  const char *name;
+  /* 'X' complete, 'b'/'e' async begin/end, 'i' instant */
+  char phase;
+  /* in microseconds, since trace_init() */
+  gint64 ts;
+  gint64 dur;
+} trace_event;
+
+static gchar *trace_path = NULL;
+static gint64 trace_start = 0;
+static GArray *trace_events = NULL;
+
+void
+trace_init(void)
+{
+  const char *path = g_getenv("OSSO_ABOOK_TRACE");
+
+  if (!path || !*path || trace_events)
+    return;
+
+  trace_path = g_strdup(path);
+  trace_start = g_get_monotonic_time();
+  trace_events = g_array_sized_new(FALSE, FALSE, sizeof(trace_event), 64);
+}
+
+static void
+trace_add(const char *name, char phase, gint64 ts, gint64 dur)
+{
+  trace_event event;
+
+  event.name = name;
+  event.phase = phase;
+  event.ts = ts - trace_start;
+  event.dur = dur;
+  g_array_append_val(trace_events, event);
+}
+
+gint64
+trace_begin(void)
+{
+  if (!trace_events)
+    return 0;
+
+  return g_get_monotonic_time();
+}
+
+void
+trace_end(const char *name, gint64 begin)
+{
+  if (trace_events && begin)
+    trace_add(name, 'X', begin, g_get_monotonic_time() - begin);
+}
+
+void
+trace_async_begin(const char *name)
+{
+  if (trace_events)
+    trace_add(name, 'b', g_get_monotonic_time(), 0);
+}
+
+void
+trace_async_end(const char *name)
+{
+  if (trace_events)
+    trace_add(name, 'e', g_get_monotonic_time(), 0);
+}
+
+void
+trace_mark(const char *name)
+{
+  if (trace_events)
+    trace_add(name, 'i', g_get_monotonic_time(), 0);
+}
+
+void
+trace_write(void)
+{
+  GString *json;
+  GError *error = NULL;
+  int pid = getpid();
+  guint i;
+
+  if (!trace_events)
+    return;
+
+  json = g_string_new("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+  for (i = 0; i < trace_events->len; i++)
+  {
+    trace_event *event = &g_array_index(trace_events, trace_event, i);
+
+    g_string_append_printf(
+          json, "%s\n{\"name\":\"%s\",\"cat\":\"startup\",\"ph\":\"%c\","
+          "\"pid\":%d,\"tid\":%d,\"ts\":%" G_GINT64_FORMAT,
+          i ? "," : "", event->name, event->phase, pid, pid, event->ts);
+
+    if (event->phase == 'X')
+      g_string_append_printf(json, ",\"dur\":%" G_GINT64_FORMAT, event->dur);
+    else if (event->phase == 'i')
+      g_string_append(json, ",\"s\":\"p\"");
+    else
+    {
+      /* async spans are matched by name */
+      g_string_append_printf(json, ",\"id\":%u", g_str_hash(event->name));
+    }
+
+    g_string_append_c(json, '}');
+  }
+
+  g_string_append(json, "\n]}\n");
+
+  if (!g_file_set_contents(trace_path, json->str, json->len, &error))
+  {
+    OSSO_ABOOK_WARN("Cannot write trace to %s: %s", trace_path,
+                    error->message);
+    g_error_free(error);
+  }
+
+  g_string_free(json, TRUE);
+}
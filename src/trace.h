@@ -0,0 +1,55 @@
+/*
+ * trace.h
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <glib.h>
+
+/* Startup timeline, in the Chrome trace format chrome://tracing and Perfetto
+ * load. Only recorded if OSSO_ABOOK_TRACE names the file to write it to.
+ * Span names must be string literals, they are kept as they are. */
+
+void
+trace_init(void);
+
+/* 0 if tracing is off, pass it to trace_end() */
+gint64
+trace_begin(void);
+
+/* a span from begin till now, spans ended that way have to nest */
+void
+trace_end(const char *name, gint64 begin);
+
+/* for spans that outlive the function starting them, like waiting for a
+ * signal. Only one span of a given name can be open at a time. */
+void
+trace_async_begin(const char *name);
+
+void
+trace_async_end(const char *name);
+
+void
+trace_mark(const char *name);
+
+/* (re)writes the file with everything recorded so far */
+void
+trace_write(void);
+
+#endif // TRACE_H
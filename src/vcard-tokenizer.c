@@ -0,0 +1,209 @@
+/*
+ * vcard-tokenizer.c
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+
+#include "vcard-tokenizer.h"
+
+#define MIN_BUFFER_SIZE 16384
+
+struct _vcard_tokenizer
+{
+  gchar *buf;
+  gsize alloc;
+
+  /* input offset of buf[0] */
+  guint64 base;
+
+  /* everything before start is consumed */
+  gsize start;
+
+  /* end of valid data */
+  gsize end;
+
+  /* the next line to look at, always at a line start */
+  gsize scan;
+
+  /* start of the card being scanned, valid if depth > 0 */
+  gsize card_start;
+  int depth;
+};
+
+vcard_tokenizer *
+vcard_tokenizer_new(void)
+{
+  return g_new0(vcard_tokenizer, 1);
+}
+
+void
+vcard_tokenizer_free(vcard_tokenizer *tokenizer)
+{
+  if (!tokenizer)
+    return;
+
+  g_free(tokenizer->buf);
+  g_free(tokenizer);
+}
+
+void
+vcard_tokenizer_reset(vcard_tokenizer *tokenizer)
+{
+  g_return_if_fail(tokenizer != NULL);
+
+  tokenizer->base += tokenizer->end;
+  tokenizer->start = 0;
+  tokenizer->end = 0;
+  tokenizer->scan = 0;
+  tokenizer->card_start = 0;
+  tokenizer->depth = 0;
+}
+
+static void
+vcard_tokenizer_compact(vcard_tokenizer *tokenizer)
+{
+  gsize shift = tokenizer->start;
+
+  if (!shift)
+    return;
+
+  memmove(tokenizer->buf, tokenizer->buf + shift, tokenizer->end - shift);
+  tokenizer->base += shift;
+  tokenizer->start = 0;
+  tokenizer->end -= shift;
+  tokenizer->scan -= shift;
+
+  if (tokenizer->depth)
+    tokenizer->card_start -= shift;
+}
+
+void
+vcard_tokenizer_feed(vcard_tokenizer *tokenizer, const gchar *buf, gsize len)
+{
+  g_return_if_fail(tokenizer != NULL);
+
+  if (!len)
+    return;
+
+  if (tokenizer->end + len > tokenizer->alloc)
+  {
+    /* Only move data once at least as much has been consumed as is still
+     * pending, that keeps the cost of compacting linear in the input size */
+    if (tokenizer->start >= tokenizer->end - tokenizer->start)
+      vcard_tokenizer_compact(tokenizer);
+
+    if (tokenizer->end + len > tokenizer->alloc)
+    {
+      gsize alloc = MAX(tokenizer->alloc * 2, MIN_BUFFER_SIZE);
+
+      while (alloc < tokenizer->end + len)
+        alloc *= 2;
+
+      tokenizer->buf = g_realloc(tokenizer->buf, alloc);
+      tokenizer->alloc = alloc;
+    }
+  }
+
+  memcpy(tokenizer->buf + tokenizer->end, buf, len);
+  tokenizer->end += len;
+}
+
+void
+vcard_tokenizer_close(vcard_tokenizer *tokenizer)
+{
+  g_return_if_fail(tokenizer != NULL);
+
+  if (tokenizer->end > tokenizer->scan)
+    vcard_tokenizer_feed(tokenizer, "\n", 1);
+}
+
+static gboolean
+line_equals(const gchar *line, gsize len, const gchar *keyword)
+{
+  gsize keyword_len = strlen(keyword);
+
+  while (len && g_ascii_isspace(line[len - 1]))
+    len--;
+
+  return len == keyword_len && !g_ascii_strncasecmp(line, keyword, len);
+}
+
+gboolean
+vcard_tokenizer_next(vcard_tokenizer *tokenizer, const gchar **card,
+                     gsize *len)
+{
+  g_return_val_if_fail(tokenizer != NULL, FALSE);
+  g_return_val_if_fail(card != NULL, FALSE);
+  g_return_val_if_fail(len != NULL, FALSE);
+
+  while (tokenizer->scan < tokenizer->end)
+  {
+    const gchar *line = tokenizer->buf + tokenizer->scan;
+    const gchar *eol = memchr(line, '\n', tokenizer->end - tokenizer->scan);
+    gsize line_len;
+
+    if (!eol)
+      break;
+
+    line_len = eol - line;
+    tokenizer->scan += line_len + 1;
+
+    if (line_equals(line, line_len, "BEGIN:VCARD"))
+    {
+      if (!tokenizer->depth)
+        tokenizer->card_start = line - tokenizer->buf;
+
+      tokenizer->depth++;
+    }
+    else if (tokenizer->depth && line_equals(line, line_len, "END:VCARD"))
+    {
+      tokenizer->depth--;
+
+      if (!tokenizer->depth)
+      {
+        *card = tokenizer->buf + tokenizer->card_start;
+        *len = tokenizer->scan - tokenizer->card_start;
+        tokenizer->start = tokenizer->scan;
+
+        return TRUE;
+      }
+    }
+
+    /* drop garbage between cards right away */
+    if (!tokenizer->depth)
+      tokenizer->start = tokenizer->scan;
+  }
+
+  return FALSE;
+}
+
+gsize
+vcard_tokenizer_get_pending(vcard_tokenizer *tokenizer)
+{
+  g_return_val_if_fail(tokenizer != NULL, 0);
+
+  return tokenizer->end - tokenizer->start;
+}
+
+guint64
+vcard_tokenizer_get_offset(vcard_tokenizer *tokenizer)
+{
+  g_return_val_if_fail(tokenizer != NULL, 0);
+
+  return tokenizer->base + tokenizer->start;
+}
@@ -0,0 +1,57 @@
+/*
+ * vcard-tokenizer.h
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef VCARD_TOKENIZER_H
+#define VCARD_TOKENIZER_H
+
+#include <glib.h>
+
+typedef struct _vcard_tokenizer vcard_tokenizer;
+
+vcard_tokenizer *
+vcard_tokenizer_new(void);
+
+void
+vcard_tokenizer_free(vcard_tokenizer *tokenizer);
+
+void
+vcard_tokenizer_feed(vcard_tokenizer *tokenizer, const gchar *buf, gsize len);
+
+/* Flushes a last line that lacks the terminating newline */
+void
+vcard_tokenizer_close(vcard_tokenizer *tokenizer);
+
+/* On success *card points inside the tokenizer buffer, it is not NUL
+ * terminated and stays valid until the next call to vcard_tokenizer_feed() */
+gboolean
+vcard_tokenizer_next(vcard_tokenizer *tokenizer, const gchar **card,
+                     gsize *len);
+
+gsize
+vcard_tokenizer_get_pending(vcard_tokenizer *tokenizer);
+
+void
+vcard_tokenizer_reset(vcard_tokenizer *tokenizer);
+
+/* Offset in the input of the first byte that is not part of a returned card or
+ * of the garbage between cards */
+guint64
+vcard_tokenizer_get_offset(vcard_tokenizer *tokenizer);
+
+#endif // VCARD_TOKENIZER_H
@@ -0,0 +1,268 @@
+/*
+ * test-backup-store.c
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <glib/gstdio.h>
+
+#include <string.h>
+
+#include "backup-store.h"
+
+typedef struct
+{
+  gchar *dir;
+  backup_store *store;
+} fixture;
+
+static void
+remove_tree(const gchar *path)
+{
+  GDir *dir = g_dir_open(path, 0, NULL);
+  const gchar *name;
+
+  while (dir && (name = g_dir_read_name(dir)))
+  {
+    gchar *child = g_build_filename(path, name, NULL);
+
+    if (g_file_test(child, G_FILE_TEST_IS_DIR))
+      remove_tree(child);
+    else
+      g_unlink(child);
+
+    g_free(child);
+  }
+
+  if (dir)
+    g_dir_close(dir);
+
+  g_rmdir(path);
+}
+
+static void
+fixture_setup(fixture *f, gconstpointer user_data)
+{
+  GError *error = NULL;
+
+  f->dir = g_dir_make_tmp("test-backup-store-XXXXXX", &error);
+  g_assert_no_error(error);
+  f->store = backup_store_open(f->dir, &error);
+  g_assert_no_error(error);
+}
+
+static void
+fixture_teardown(fixture *f, gconstpointer user_data)
+{
+  backup_store_free(f->store);
+  remove_tree(f->dir);
+  g_free(f->dir);
+}
+
+static gchar *
+put(fixture *f, const gchar *data)
+{
+  GError *error = NULL;
+  gchar *hash = backup_store_put(f->store, data, strlen(data), &error);
+
+  g_assert_no_error(error);
+
+  return hash;
+}
+
+static gboolean
+has_object(fixture *f, const gchar *hash)
+{
+  GError *error = NULL;
+  GBytes *object = backup_store_get(f->store, hash, &error);
+
+  if (!object)
+  {
+    g_assert_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT);
+    g_error_free(error);
+
+    return FALSE;
+  }
+
+  g_bytes_unref(object);
+
+  return TRUE;
+}
+
+/* generations are named after the second they were made in */
+static gchar *
+new_generation(fixture *f, const gchar *previous)
+{
+  GError *error = NULL;
+  gchar *generation;
+
+  while ((generation = backup_store_new_generation(f->store, &error)) &&
+         !g_strcmp0(generation, previous))
+  {
+    g_free(generation);
+    g_usleep(G_USEC_PER_SEC / 10);
+  }
+
+  g_assert_no_error(error);
+
+  return generation;
+}
+
+/* books without an index in the generation are listed in the manifest
+ * anyway, as if the index got lost */
+static void
+commit_generation(fixture *f, const gchar *generation, const gchar *index,
+                  const gchar * const *books)
+{
+  GKeyFile *manifest = g_key_file_new();
+  GError *error = NULL;
+
+  backup_store_write_index(f->store, generation, books[0], index, &error);
+  g_assert_no_error(error);
+
+  g_key_file_set_string_list(manifest, BACKUP_MANIFEST_GROUP, "books", books,
+                             g_strv_length((gchar **)books));
+  backup_store_commit_generation(f->store, generation, manifest, &error);
+  g_assert_no_error(error);
+  g_key_file_free(manifest);
+}
+
+static void
+test_put_get(fixture *f, gconstpointer user_data)
+{
+  const gchar *data = "BEGIN:VCARD\r\nFN:John Doe\r\nEND:VCARD\r\n";
+  GError *error = NULL;
+  gchar *hash = put(f, data);
+  gchar *again;
+  GBytes *object;
+
+  g_assert_cmpuint(backup_store_get_written_bytes(f->store), ==,
+                   strlen(data));
+
+  /* stored once */
+  again = put(f, data);
+  g_assert_cmpstr(hash, ==, again);
+  g_assert_cmpuint(backup_store_get_written_bytes(f->store), ==,
+                   strlen(data));
+
+  object = backup_store_get(f->store, hash, &error);
+  g_assert_no_error(error);
+  g_assert_cmpuint(g_bytes_get_size(object), ==, strlen(data));
+  g_assert_true(!memcmp(g_bytes_get_data(object, NULL), data, strlen(data)));
+
+  g_assert_null(backup_store_get(f->store, "../manifest", &error));
+  g_assert_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL);
+  g_clear_error(&error);
+
+  g_bytes_unref(object);
+  g_free(again);
+  g_free(hash);
+}
+
+/* objects only the dropped generations refer to go with them */
+static void
+test_prune(fixture *f, gconstpointer user_data)
+{
+  const gchar *books[] = { "system", NULL };
+  gchar *a = put(f, "a");
+  gchar *b = put(f, "b");
+  gchar *c = put(f, "c");
+  gchar *old = new_generation(f, NULL);
+  gchar *index = g_strconcat(a, "\n", b, "\n", NULL);
+  gchar *newest;
+  gchar *incomplete;
+  gchar **generations;
+  GError *error = NULL;
+
+  commit_generation(f, old, index, books);
+  g_free(index);
+
+  newest = new_generation(f, old);
+  index = g_strconcat(b, " ", c, "\n", NULL);
+  commit_generation(f, newest, index, books);
+  g_free(index);
+
+  /* a backup that failed half way */
+  incomplete = new_generation(f, newest);
+
+  g_assert_true(backup_store_prune(f->store, 1, &error));
+  g_assert_no_error(error);
+
+  generations = backup_store_list_generations(f->store);
+  g_assert_cmpuint(g_strv_length(generations), ==, 1);
+  g_assert_cmpstr(generations[0], ==, newest);
+  g_strfreev(generations);
+
+  g_assert_false(has_object(f, a));
+  g_assert_true(has_object(f, b));
+  g_assert_true(has_object(f, c));
+
+  g_free(incomplete);
+  g_free(newest);
+  g_free(old);
+  g_free(c);
+  g_free(b);
+  g_free(a);
+}
+
+/* if what the kept generations refer to cannot be read, nothing goes */
+static void
+test_prune_unreadable(fixture *f, gconstpointer user_data)
+{
+  const gchar *old_books[] = { "system", NULL };
+  const gchar *books[] = { "system", "lost", NULL };
+  gchar *a = put(f, "a");
+  gchar *b = put(f, "b");
+  gchar *old = new_generation(f, NULL);
+  gchar *index = g_strconcat(a, "\n", NULL);
+  gchar *newest;
+  GError *error = NULL;
+
+  commit_generation(f, old, index, old_books);
+  g_free(index);
+
+  newest = new_generation(f, old);
+  index = g_strconcat(b, "\n", NULL);
+  commit_generation(f, newest, index, books);
+  g_free(index);
+
+  g_assert_false(backup_store_prune(f->store, 1, &error));
+  g_assert_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT);
+  g_clear_error(&error);
+
+  g_assert_true(has_object(f, a));
+  g_assert_true(has_object(f, b));
+
+  g_free(newest);
+  g_free(old);
+  g_free(b);
+  g_free(a);
+}
+
+int
+main(int argc, char **argv)
+{
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add("/backup-store/put-get", fixture, NULL, fixture_setup,
+             test_put_get, fixture_teardown);
+  g_test_add("/backup-store/prune", fixture, NULL, fixture_setup,
+             test_prune, fixture_teardown);
+  g_test_add("/backup-store/prune-unreadable", fixture, NULL, fixture_setup,
+             test_prune_unreadable, fixture_teardown);
+
+  return g_test_run();
+}
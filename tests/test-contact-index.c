@@ -0,0 +1,164 @@
+/*
+ * test-contact-index.c
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "contact-index.h"
+
+#define JOHN \
+  "BEGIN:VCARD\r\n" \
+  "VERSION:3.0\r\n" \
+  "UID:john\r\n" \
+  "FN:John Doe\r\n" \
+  "TEL;TYPE=CELL:+44 20 7946 0018\r\n" \
+  "EMAIL:John.Doe@example.com\r\n" \
+  "END:VCARD\r\n"
+
+static EContact *
+contact_new(const gchar *vcard)
+{
+  EContact *contact = e_contact_new_from_vcard(vcard);
+
+  g_assert_nonnull(contact);
+
+  return contact;
+}
+
+static void
+assert_normalized(const gchar *number, const gchar *expected)
+{
+  gchar *normalized = contact_index_normalize_phone(number);
+
+  g_assert_cmpstr(normalized, ==, expected);
+  g_free(normalized);
+}
+
+static void
+test_normalize_phone(void)
+{
+  assert_normalized("+44 (20) 7946-0018", "9460018");
+  assert_normalized("020 7946 0018", "9460018");
+  assert_normalized("555-0199p1234", "5550199");
+  assert_normalized("555,1234", "555");
+  assert_normalized("112", "112");
+  assert_normalized("", "");
+}
+
+static contact_index_match
+lookup(contact_index *index, const gchar *vcard, const gchar **uid)
+{
+  EContact *contact = contact_new(vcard);
+  contact_index_match match;
+
+  *uid = NULL;
+  match = contact_index_lookup(index, contact, uid);
+  g_object_unref(contact);
+
+  return match;
+}
+
+static void
+test_lookup(void)
+{
+  contact_index *index = contact_index_new();
+  EContact *john = contact_new(JOHN);
+  const gchar *uid;
+
+  contact_index_add(index, john);
+  g_object_unref(john);
+
+  g_assert_cmpint(lookup(index, JOHN, &uid), ==, CONTACT_INDEX_IDENTICAL);
+  g_assert_cmpstr(uid, ==, "john");
+
+  /* the same card exported from somewhere else */
+  g_assert_cmpint(lookup(index,
+                         "BEGIN:VCARD\r\n"
+                         "VERSION:2.1\r\n"
+                         "FN:John Doe\r\n"
+                         "TEL;TYPE=CELL:+44 20 7946 0018\r\n"
+                         "EMAIL:John.Doe@example.com\r\n"
+                         "END:VCARD\r\n", &uid),
+                  ==, CONTACT_INDEX_IDENTICAL);
+  g_assert_cmpstr(uid, ==, "john");
+
+  /* written differently, but the same person */
+  g_assert_cmpint(lookup(index,
+                         "BEGIN:VCARD\r\n"
+                         "VERSION:3.0\r\n"
+                         "FN:  john   DOE \r\n"
+                         "TEL;TYPE=CELL:020 7946 0018\r\n"
+                         "EMAIL:john.doe@EXAMPLE.com\r\n"
+                         "END:VCARD\r\n", &uid),
+                  ==, CONTACT_INDEX_CHANGED);
+  g_assert_cmpstr(uid, ==, "john");
+
+  g_assert_cmpint(lookup(index,
+                         "BEGIN:VCARD\r\n"
+                         "VERSION:3.0\r\n"
+                         "FN:Jane Doe\r\n"
+                         "TEL;TYPE=CELL:+44 20 7946 0018\r\n"
+                         "EMAIL:John.Doe@example.com\r\n"
+                         "END:VCARD\r\n", &uid),
+                  ==, CONTACT_INDEX_NEW);
+  g_assert_null(uid);
+
+  contact_index_free(index);
+}
+
+/* attribute order and whatever changes on every store do not count */
+static void
+test_content_hash(void)
+{
+  EContact *john = contact_new(JOHN);
+  EContact *stored = contact_new("BEGIN:VCARD\r\n"
+                                 "VERSION:3.0\r\n"
+                                 "EMAIL:John.Doe@example.com\r\n"
+                                 "UID:stored\r\n"
+                                 "REV:2026-01-01T00:00:00Z\r\n"
+                                 "TEL;TYPE=CELL:+44 20 7946 0018\r\n"
+                                 "FN:John Doe\r\n"
+                                 "PHOTO;VALUE=uri:file:///tmp/john.jpg\r\n"
+                                 "END:VCARD\r\n");
+  gchar *a = contact_index_content_hash(john);
+  gchar *b = contact_index_content_hash(stored);
+
+  g_assert_cmpstr(a, ==, b);
+  g_free(b);
+  g_free(a);
+
+  /* a new photo is a change for the export */
+  a = contact_index_full_hash(john);
+  b = contact_index_full_hash(stored);
+  g_assert_cmpstr(a, !=, b);
+  g_free(b);
+  g_free(a);
+
+  g_object_unref(stored);
+  g_object_unref(john);
+}
+
+int
+main(int argc, char **argv)
+{
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/contact-index/normalize-phone", test_normalize_phone);
+  g_test_add_func("/contact-index/lookup", test_lookup);
+  g_test_add_func("/contact-index/content-hash", test_content_hash);
+
+  return g_test_run();
+}
@@ -0,0 +1,188 @@
+/*
+ * test-vcard-tokenizer.c
+ *
+ * Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+
+#include "vcard-tokenizer.h"
+
+#define CARD1 \
+  "BEGIN:VCARD\r\n" \
+  "VERSION:3.0\r\n" \
+  "FN:John Doe\r\n" \
+  "END:VCARD\r\n"
+
+#define CARD2 \
+  "BEGIN:VCARD\n" \
+  "VERSION:2.1\n" \
+  "AGENT:\n" \
+  "BEGIN:VCARD\n" \
+  "FN:Agent\n" \
+  "END:VCARD\n" \
+  "FN:Jane Doe\n" \
+  "END:VCARD\n"
+
+#define GARBAGE "not a card\r\n\r\n"
+
+static const gchar *input = GARBAGE CARD1 GARBAGE CARD2 GARBAGE;
+
+/* cards are copied, they only live until the next feed */
+static void
+drain(vcard_tokenizer *tokenizer, GPtrArray *cards)
+{
+  const gchar *card;
+  gsize len;
+
+  while (vcard_tokenizer_next(tokenizer, &card, &len))
+    g_ptr_array_add(cards, g_strndup(card, len));
+}
+
+static void
+assert_cards(GPtrArray *cards)
+{
+  g_assert_cmpuint(cards->len, ==, 2);
+  g_assert_cmpstr(g_ptr_array_index(cards, 0), ==, CARD1);
+  g_assert_cmpstr(g_ptr_array_index(cards, 1), ==, CARD2);
+}
+
+/* whatever the chunks are, the same cards come out */
+static void
+test_split(void)
+{
+  gsize len = strlen(input);
+  gsize split;
+
+  for (split = 0; split <= len; split++)
+  {
+    vcard_tokenizer *tokenizer = vcard_tokenizer_new();
+    GPtrArray *cards = g_ptr_array_new_with_free_func(g_free);
+
+    vcard_tokenizer_feed(tokenizer, input, split);
+    drain(tokenizer, cards);
+    vcard_tokenizer_feed(tokenizer, input + split, len - split);
+    drain(tokenizer, cards);
+    vcard_tokenizer_close(tokenizer);
+    drain(tokenizer, cards);
+
+    assert_cards(cards);
+    g_assert_cmpuint(vcard_tokenizer_get_offset(tokenizer), ==, len);
+    g_assert_cmpuint(vcard_tokenizer_get_pending(tokenizer), ==, 0);
+
+    g_ptr_array_free(cards, TRUE);
+    vcard_tokenizer_free(tokenizer);
+  }
+}
+
+static void
+test_bytewise(void)
+{
+  vcard_tokenizer *tokenizer = vcard_tokenizer_new();
+  GPtrArray *cards = g_ptr_array_new_with_free_func(g_free);
+  const gchar *p;
+
+  for (p = input; *p; p++)
+  {
+    vcard_tokenizer_feed(tokenizer, p, 1);
+    drain(tokenizer, cards);
+  }
+
+  assert_cards(cards);
+  g_assert_cmpuint(vcard_tokenizer_get_offset(tokenizer), ==, strlen(input));
+
+  g_ptr_array_free(cards, TRUE);
+  vcard_tokenizer_free(tokenizer);
+}
+
+/* the offset stays at the start of a card until all of it is there */
+static void
+test_offset(void)
+{
+  vcard_tokenizer *tokenizer = vcard_tokenizer_new();
+  const gchar *card;
+  gsize len;
+
+  vcard_tokenizer_feed(tokenizer, GARBAGE CARD1, strlen(GARBAGE) + 20);
+  g_assert_false(vcard_tokenizer_next(tokenizer, &card, &len));
+  g_assert_cmpuint(vcard_tokenizer_get_offset(tokenizer), ==,
+                   strlen(GARBAGE));
+
+  vcard_tokenizer_feed(tokenizer, CARD1 + 20, strlen(CARD1) - 20);
+  g_assert_true(vcard_tokenizer_next(tokenizer, &card, &len));
+  g_assert_cmpuint(len, ==, strlen(CARD1));
+  g_assert_cmpuint(vcard_tokenizer_get_offset(tokenizer), ==,
+                   strlen(GARBAGE CARD1));
+
+  vcard_tokenizer_free(tokenizer);
+}
+
+static void
+test_no_final_newline(void)
+{
+  vcard_tokenizer *tokenizer = vcard_tokenizer_new();
+  const gchar *card;
+  gsize len;
+
+  vcard_tokenizer_feed(tokenizer, CARD1, strlen(CARD1) - 2);
+  g_assert_false(vcard_tokenizer_next(tokenizer, &card, &len));
+
+  vcard_tokenizer_close(tokenizer);
+  g_assert_true(vcard_tokenizer_next(tokenizer, &card, &len));
+  g_assert_cmpuint(len, ==, strlen(CARD1) - 1);
+  g_assert_true(!strncmp(card, CARD1, len - 1));
+
+  vcard_tokenizer_free(tokenizer);
+}
+
+/* a card that is not ended is dropped, the offset moves past it */
+static void
+test_reset(void)
+{
+  vcard_tokenizer *tokenizer = vcard_tokenizer_new();
+  GPtrArray *cards = g_ptr_array_new_with_free_func(g_free);
+
+  vcard_tokenizer_feed(tokenizer, "BEGIN:VCARD\nFN:Never ended\n", 27);
+  drain(tokenizer, cards);
+  g_assert_cmpuint(cards->len, ==, 0);
+  g_assert_cmpuint(vcard_tokenizer_get_pending(tokenizer), ==, 27);
+
+  vcard_tokenizer_reset(tokenizer);
+  g_assert_cmpuint(vcard_tokenizer_get_pending(tokenizer), ==, 0);
+  g_assert_cmpuint(vcard_tokenizer_get_offset(tokenizer), ==, 27);
+
+  vcard_tokenizer_feed(tokenizer, CARD1, strlen(CARD1));
+  drain(tokenizer, cards);
+  g_assert_cmpuint(cards->len, ==, 1);
+  g_assert_cmpstr(g_ptr_array_index(cards, 0), ==, CARD1);
+
+  g_ptr_array_free(cards, TRUE);
+  vcard_tokenizer_free(tokenizer);
+}
+
+int
+main(int argc, char **argv)
+{
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/vcard-tokenizer/split", test_split);
+  g_test_add_func("/vcard-tokenizer/bytewise", test_bytewise);
+  g_test_add_func("/vcard-tokenizer/offset", test_offset);
+  g_test_add_func("/vcard-tokenizer/no-final-newline", test_no_final_newline);
+  g_test_add_func("/vcard-tokenizer/reset", test_reset);
+
+  return g_test_run();
+}